@@ -0,0 +1,135 @@
+// Copyright 2020 Markus Bjønnes and Marius Nilsen.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "controller_interface/controller_interface.hpp"
+#include "hardware_interface/operation_mode_handle.hpp"
+#include "hardware_interface/robot_hardware.hpp"
+#include "rclcpp_lifecycle/state.hpp"
+#include <controllers/cartesian_kinematics.hpp>
+#include <controllers/command_claims.hpp>
+#include <controllers/visibility_control.h>
+#include "sensor_msgs/msg/joint_state.hpp"
+#include <std_msgs/msg/bool.hpp>
+#include "ros2_control_interfaces/msg/indexed_joint_control.hpp"
+#include "ros2_control_utils/realtime_buffer.hpp"
+
+
+namespace ros_controllers
+{
+
+class AdmittanceController : public controller_interface::ControllerInterface
+{
+public:
+  ROS_CONTROLLERS_PUBLIC
+  AdmittanceController();
+
+  ROS_CONTROLLERS_PUBLIC
+  controller_interface::controller_interface_ret_t
+  init(std::weak_ptr<hardware_interface::RobotHardware> robot_hardware, const std::string & controller_name) override;
+
+  ROS_CONTROLLERS_PUBLIC
+  controller_interface::controller_interface_ret_t
+  update() override;
+
+  ROS_CONTROLLERS_PUBLIC
+  rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
+  on_configure(const rclcpp_lifecycle::State & previous_state) override;
+
+  ROS_CONTROLLERS_PUBLIC
+  rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
+  on_activate(const rclcpp_lifecycle::State & previous_state) override;
+
+  ROS_CONTROLLERS_PUBLIC
+  rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
+  on_deactivate(const rclcpp_lifecycle::State & previous_state) override;
+
+  ROS_CONTROLLERS_PUBLIC
+  rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
+  on_cleanup(const rclcpp_lifecycle::State & previous_state) override;
+
+private:
+  using Vector6 = CartesianKinematics::Vector6;
+  static constexpr size_t MAX_JOINTS = ros2_control_interfaces::msg::IndexedJointControl::MAX_JOINTS;
+
+  // Latest external joint torques, in controller joint order
+  struct TorqueSample
+  {
+    std::array<double, MAX_JOINTS> torques{};
+    int64_t stamp_ns = 0;  // Wall clock time of reception, 0 if none was received
+  };
+
+  // As for the cartesian_velocity_controller, the commands are only written while enabled and until the joints are
+  // at rest after it is disabled
+  enum AdmittanceState
+  {
+    IDLE,
+    COMPLIANT,
+    DECELERATING
+  };
+
+  void external_torque_callback(sensor_msgs::msg::JointState::UniquePtr msg);
+  void set_op_mode(const hardware_interface::OperationMode & mode);
+  void reset();
+
+  std::vector<std::string> joint_names_;
+  std::vector<std::string> write_op_names_;
+  std::string command_interface_ = "position";
+  std::vector<hardware_interface::JointCommandHandle *> registered_joint_cmd_handles_;
+  std::vector<hardware_interface::JointCommandHandle *> registered_joint_vel_cmd_handles_;
+  std::vector<hardware_interface::JointCommandHandle *> claim_handles_;  // Empty without command arbitration
+  std::vector<hardware_interface::OperationModeHandle *> registered_operation_mode_handles_;
+
+  CartesianKinematics kinematics_;
+  JointMotionLimits limits_;
+
+  // Preallocated, so the control loop does not allocate
+  std::vector<double> commanded_positions_;
+  std::vector<double> commanded_velocities_;
+  std::vector<double> desired_velocities_;
+  std::vector<double> torques_;
+
+  rclcpp::Subscription<sensor_msgs::msg::JointState>::SharedPtr external_torque_subscriber_;
+  rclcpp::Subscription<std_msgs::msg::Bool>::SharedPtr enable_subscriber_;
+  control_utils::RealtimeBuffer<TorqueSample> torque_buffer_;
+  std::atomic<bool> enabled_{false};
+  bool subscriber_is_active_ = false;
+
+  // Virtual mass-damper-spring at the TCP, M a + D v + K x = F, per axis of [x y z rx ry rz]. x is the displacement
+  // from where the controller was enabled, integrated from v, so K pulls back towards it. With K = 0 the arm is
+  // led through freely.
+  AdmittanceState admittance_state_ = IDLE;
+  Vector6 displacement_ = Vector6::Zero();
+  Vector6 velocity_ = Vector6::Zero();
+  Vector6 mass_ = Vector6::Zero();
+  Vector6 damping_ = Vector6::Zero();
+  Vector6 stiffness_ = Vector6::Zero();
+  int64_t last_update_ns_ = 0;
+  rclcpp::Clock::SharedPtr clock_;  // Of the node, for update() and the stamps it compares with
+
+  double force_deadband_ = 3.0;            // [N] of estimation error the arm does not move for
+  double torque_deadband_ = 0.3;           // [Nm]
+  double torque_timeout_ = 0.1;            // [s] after which the arm is stopped without external torques
+  double max_linear_velocity_ = 0.25;      // [m/s]
+  double max_angular_velocity_ = 1.0;      // [rad/s]
+  double singularity_damping_ = 0.05;      // [m] of the damped least squares inverses
+};
+
+}  // namespace ros_controllers
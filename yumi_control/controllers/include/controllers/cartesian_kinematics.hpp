@@ -0,0 +1,93 @@
+// Copyright 2020 Markus Bjønnes and Marius Nilsen.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <Eigen/Core>
+#include <kdl/chain.hpp>
+#include <kdl/chainjnttojacsolver.hpp>
+#include <kdl/jacobian.hpp>
+#include <kdl/jntarray.hpp>
+
+
+namespace ros_controllers
+{
+
+/**
+ * @brief Differential kinematics at the TCP of an arm, for the Cartesian controllers.
+ *
+ * The chain of the arm comes from the KdlWrapper. Twists and wrenches are at the tip of the chain, expressed in its
+ * base frame, as [x y z rx ry rz]. Joint vectors are in controller joint order. Nothing is allocated after init(), so
+ * the other members can be called from the control loop.
+ */
+class CartesianKinematics
+{
+public:
+  using Vector6 = Eigen::Matrix<double, 6, 1>;
+
+  CartesianKinematics() = default;
+  CartesianKinematics(const CartesianKinematics &) = delete;
+  CartesianKinematics & operator=(const CartesianKinematics &) = delete;
+
+  /**
+   * @brief Loads the chain of planning_component, left_arm or right_arm, from the urdf at urdf_path.
+   *
+   * Every joint of the chain must be in joint_names. Returns false with a description in error otherwise.
+   */
+  bool init(const std::string & urdf_path, const std::string & planning_component,
+            const std::vector<std::string> & joint_names, std::string & error);
+
+  /* Computes the Jacobian at positions. Returns false if it could not be computed. */
+  bool update(const std::vector<double> & positions);
+
+  /* Joint velocities of twist, by the damped least squares inverse J^T (J J^T + damping^2 I)^-1 of the Jacobian. */
+  void twist_to_joint_velocities(const Vector6 & twist, double damping, std::vector<double> & velocities);
+
+  /* TCP wrench balancing the joint torques, (J J^T + damping^2 I)^-1 J torques. */
+  Vector6 torques_to_wrench(const std::vector<double> & torques, double damping);
+
+private:
+  Vector6 damped_solve(const Vector6 & vector, double damping) const;
+
+  KDL::Chain chain_;
+  std::unique_ptr<KDL::ChainJntToJacSolver> jacobian_solver_;
+  std::vector<size_t> chain_joints_;  // Controller index of every joint of the chain
+  KDL::JntArray chain_positions_;
+  KDL::Jacobian jacobian_;
+  Eigen::VectorXd chain_vector_;
+};
+
+/* Joint limits the Cartesian controllers move within. Empty limits are not checked. */
+struct JointMotionLimits
+{
+  std::vector<double> min_positions;
+  std::vector<double> max_positions;
+  std::vector<double> max_velocities;
+  double max_acceleration = 2.0;  // [rad/s^2], of every joint
+};
+
+/**
+ * @brief Moves the commanded joint state towards desired_velocities over dt, within limits.
+ *
+ * The desired velocities, and then the change of the commanded velocities, are scaled down together, so the joints
+ * keep moving along the same direction. Joints reaching a position limit stop there. Returns true if the joints are
+ * at rest afterwards.
+ */
+bool integrate_joint_velocities(const JointMotionLimits & limits, std::vector<double> & desired_velocities, double dt,
+                                std::vector<double> & positions, std::vector<double> & velocities);
+
+}  // namespace ros_controllers
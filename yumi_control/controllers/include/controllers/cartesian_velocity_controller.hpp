@@ -0,0 +1,118 @@
+// Copyright 2020 Markus Bjønnes and Marius Nilsen.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+#include "controller_interface/controller_interface.hpp"
+#include "geometry_msgs/msg/twist_stamped.hpp"
+#include "hardware_interface/operation_mode_handle.hpp"
+#include "hardware_interface/robot_hardware.hpp"
+#include "rclcpp_lifecycle/state.hpp"
+#include <controllers/cartesian_kinematics.hpp>
+#include <controllers/command_claims.hpp>
+#include <controllers/visibility_control.h>
+#include "ros2_control_utils/realtime_buffer.hpp"
+
+
+namespace ros_controllers
+{
+
+class CartesianVelocityController : public controller_interface::ControllerInterface
+{
+public:
+  ROS_CONTROLLERS_PUBLIC
+  CartesianVelocityController();
+
+  ROS_CONTROLLERS_PUBLIC
+  controller_interface::controller_interface_ret_t
+  init(std::weak_ptr<hardware_interface::RobotHardware> robot_hardware, const std::string & controller_name) override;
+
+  ROS_CONTROLLERS_PUBLIC
+  controller_interface::controller_interface_ret_t
+  update() override;
+
+  ROS_CONTROLLERS_PUBLIC
+  rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
+  on_configure(const rclcpp_lifecycle::State & previous_state) override;
+
+  ROS_CONTROLLERS_PUBLIC
+  rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
+  on_activate(const rclcpp_lifecycle::State & previous_state) override;
+
+  ROS_CONTROLLERS_PUBLIC
+  rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
+  on_deactivate(const rclcpp_lifecycle::State & previous_state) override;
+
+  ROS_CONTROLLERS_PUBLIC
+  rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
+  on_cleanup(const rclcpp_lifecycle::State & previous_state) override;
+
+private:
+  // Latest TCP twist, [vx vy vz wx wy wz] in the base frame of the chain
+  struct TwistCommand
+  {
+    std::array<double, 6> twist{};
+    int64_t stamp_ns = 0;  // Wall clock time of reception, 0 if none was received
+  };
+
+  // IDLE leaves the joint commands to the other controllers, the commands are only written while servoing and until
+  // the joints have been decelerated to rest after the twists stop
+  enum ServoState
+  {
+    IDLE,
+    SERVOING,
+    DECELERATING
+  };
+
+  void twist_callback(geometry_msgs::msg::TwistStamped::UniquePtr msg);
+  void set_op_mode(const hardware_interface::OperationMode & mode);
+  void reset();
+
+  std::vector<std::string> joint_names_;
+  std::vector<std::string> write_op_names_;
+  // As for the joint_trajectory_controller, "reference" writes the <joint>_ref handles of a chained
+  // joint_position_controller
+  std::string command_interface_ = "position";
+  std::vector<hardware_interface::JointCommandHandle *> registered_joint_cmd_handles_;
+  std::vector<hardware_interface::JointCommandHandle *> registered_joint_vel_cmd_handles_;
+  std::vector<hardware_interface::JointCommandHandle *> claim_handles_;  // Empty without command arbitration
+  std::vector<hardware_interface::OperationModeHandle *> registered_operation_mode_handles_;
+
+  CartesianKinematics kinematics_;
+  JointMotionLimits limits_;
+
+  // Preallocated, so the control loop does not allocate
+  std::vector<double> commanded_positions_;
+  std::vector<double> commanded_velocities_;
+  std::vector<double> desired_velocities_;
+
+  bool subscriber_is_active_ = false;
+  rclcpp::Subscription<geometry_msgs::msg::TwistStamped>::SharedPtr twist_subscriber_;
+  control_utils::RealtimeBuffer<TwistCommand> twist_buffer_;
+
+  ServoState servo_state_ = IDLE;
+  int64_t last_update_ns_ = 0;
+  rclcpp::Clock::SharedPtr clock_;  // Of the node, for update() and the stamps it compares with
+
+  double damping_ = 0.05;                 // [m] of the damped least squares inverse
+  double twist_timeout_ = 0.1;            // [s] after which the twist is taken as zero
+  double max_linear_velocity_ = 0.25;     // [m/s]
+  double max_angular_velocity_ = 1.0;     // [rad/s]
+};
+
+}  // namespace ros_controllers
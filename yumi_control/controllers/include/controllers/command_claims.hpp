@@ -0,0 +1,73 @@
+// Copyright 2020 Markus Bjønnes and Marius Nilsen.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "hardware_interface/robot_hardware.hpp"
+
+
+namespace ros_controllers
+{
+
+// Joint commands are arbitrated by priority in the hardware node, see abb_egm_hardware::CommandArbiter. Writing
+// COMMAND_CLAIM to the <command>_claim handle keeps controllers of lower priority off <command> and <command>_vel until
+// COMMAND_RELEASE is written, or the controller is switched out. A controller whose claim another one took over, or
+// refused, reads COMMAND_TAKEN there at the start of its next update, and continues from the current commands.
+constexpr double COMMAND_CLAIM = 1.0;
+constexpr double COMMAND_RELEASE = 0.0;
+constexpr double COMMAND_TAKEN = -1.0;
+
+/* The claim handles of the given commands, empty if the hardware has none, e.g. without the arbiter. */
+inline std::vector<hardware_interface::JointCommandHandle *>
+get_claim_handles(hardware_interface::RobotHardware & robot_hardware, const std::vector<std::string> & command_names)
+{
+  std::vector<hardware_interface::JointCommandHandle *> claim_handles(command_names.size(), nullptr);
+  for (size_t index = 0; index < command_names.size(); ++index) 
+  {
+    if (robot_hardware.get_joint_command_handle((command_names[index] + "_claim").c_str(), &claim_handles[index]) 
+        != hardware_interface::HW_RET_OK) 
+    {
+      return {};
+    }
+  }
+  return claim_handles;
+}
+
+/* Whether another controller took any of the commands over since the last update. Read before claiming. Realtime. */
+inline bool
+claims_taken(const std::vector<hardware_interface::JointCommandHandle *> & claim_handles)
+{
+  for (auto * claim_handle : claim_handles) 
+  {
+    if (claim_handle->get_cmd() == COMMAND_TAKEN) 
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Writes COMMAND_CLAIM or COMMAND_RELEASE to every claim handle. Realtime. */
+inline void
+set_claims(const std::vector<hardware_interface::JointCommandHandle *> & claim_handles, double claim)
+{
+  for (auto * claim_handle : claim_handles) 
+  {
+    claim_handle->set_cmd(claim);
+  }
+}
+
+}  // namespace ros_controllers
@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -23,24 +25,47 @@
 
 #include "hardware_interface/robot_hardware.hpp"
 
+#include "rclcpp_lifecycle/lifecycle_publisher.hpp"
 #include "rclcpp_lifecycle/state.hpp"
 
+#include "controllers/tracking_error_stats.hpp"
 #include "controllers/visibility_control.h"
 
 #include "sensor_msgs/msg/joint_state.hpp"
 
 #include "ros2_control_interfaces/msg/joint_control.hpp"
+#include "ros2_control_interfaces/msg/indexed_joint_control.hpp"
+#include "ros2_control_interfaces/msg/pid_parameters.hpp"
 
 // parameter server services
 #include "parameter_server_interfaces/srv/get_controller_pid.hpp"
 #include "parameter_server_interfaces/srv/get_controller_joints.hpp"
 
+#include "ros2_control_utils/joint_order_hash.hpp"
 #include "ros2_control_utils/pid.hpp"
+#include "ros2_control_utils/pid_bank.hpp"
+#include "ros2_control_utils/realtime_buffer.hpp"
+#include "ros2_control_utils/tracking_statistics.hpp"
 
 
 namespace ros_controllers
 {
 
+// Upper bound on the number of joints a single position controller can command.
+constexpr std::size_t MAX_CONTROLLER_JOINTS = control_utils::PidBank::MAX_JOINTS;
+
+// Desired joint positions in controller joint order.
+using JointTargets = control_utils::PidBank::JointArray;
+
+// Desired joint motion in controller joint order, as received at stamp_ns on the controller clock.
+struct JointReference
+{
+  JointTargets positions = {};
+  JointTargets velocities = {};
+  JointTargets accelerations = {};
+  int64_t stamp_ns = 0;
+};
+
 class JointPositionController : public controller_interface::ControllerInterface
 {
 public:
@@ -85,23 +110,85 @@ private:
   // Joint handles
   std::vector<hardware_interface::JointCommandHandle*> registered_joint_cmd_handles_ = {};
   std::vector<const hardware_interface::JointStateHandle*> registered_joint_state_handles_ = {};
+  std::vector<hardware_interface::JointCommandHandle*> registered_joint_vel_cmd_handles_ = {};
+
+  // Chained reference input. With reference_input "handles" the reference is read every cycle from the <joint>_ref
+  // and <joint>_ref_vel handles a joint_trajectory_controller with command_interface "reference" writes, instead of
+  // from the joint command topics. That controller must be updated first, i.e. loaded before this one.
+  bool reference_from_handles_ = false;
+  std::vector<hardware_interface::JointCommandHandle*> registered_joint_ref_handles_ = {};
+  std::vector<hardware_interface::JointCommandHandle*> registered_joint_ref_vel_handles_ = {};
+  JointReference handle_reference_ = {};
+  bool handle_reference_moving_ = false;
+
+  // Feedforward mode: the reference velocity and acceleration are added to the command, the pid only corrects the
+  // residual error, and both position and velocity commands are written.
+  bool feedforward_ = false;
+  double feedforward_horizon_ = 0.1;  /**< [s] How far a reference is extrapolated before it is held. */
   
-  std::vector<std::shared_ptr<control_utils::Pid>> pid_controllers_ = {};
+  // One pid per joint, in controller joint order, computed together
+  control_utils::PidBank pid_bank_;
+  JointTargets errors_ = {};
+  JointTargets additions_ = {};
+  JointTargets ref_positions_ = {};
+  JointTargets ref_velocities_ = {};
+  JointTargets ref_accelerations_ = {};
+
+  // Joint name -> index in controller joint order. Only modified while configuring.
+  std::unordered_map<std::string, std::size_t> joint_index_map_ = {};
+
+  // Desired motion handed from the subscription callback to update() without locking.
+  // pending_reference_ is the callback's working copy, as a message may only address some of the joints.
+  JointReference pending_reference_ = {};
+  control_utils::RealtimeBuffer<JointReference> desired_pos_buffer_;
 
-  std::unordered_map<std::string, double> desired_pos_map_ = {};
-  std::unordered_map<std::string, std::shared_ptr<control_utils::Pid>> pid_controllers_map_ = {};
+  // Indexed joint commands carry this hash of the controller joint order instead of joint names
+  uint32_t joint_order_hash_ = 0;
+  int64_t last_indexed_stamp_ns_ = 0;
 
 
   rclcpp::Subscription<ros2_control_interfaces::msg::JointControl>::SharedPtr subscription_;
+  rclcpp::Subscription<ros2_control_interfaces::msg::IndexedJointControl>::SharedPtr indexed_subscription_;
+  rclcpp::Subscription<ros2_control_interfaces::msg::PidParameters>::SharedPtr pid_parameters_subscription_;
 
   rclcpp::Time previous_update_time_;
 
+  // Tracking error statistics, a segment lasts from one received reference to the next. Computed by update() and
+  // published on ~/tracking_error at tracking_stats_rate.
+  std::vector<std::string> joint_names_ = {};
+  control_utils::TrackingStatistics tracking_statistics_;
+  control_utils::RealtimeBuffer<control_utils::TrackingSummary> tracking_buffer_;
+  int64_t tracked_stamp_ns_ = 0;
+  std::shared_ptr<rclcpp_lifecycle::LifecyclePublisher<ros2_control_interfaces::msg::TrackingErrorStats>> 
+    tracking_publisher_;
+  rclcpp::TimerBase::SharedPtr tracking_timer_;
+  ros2_control_interfaces::msg::TrackingErrorStats tracking_msg_;
+  double settling_tolerance_ = 0.01;  /**< [rad] */
+  double tracking_stats_rate_ = 1.0;  /**< [Hz] */
+
   // Configuration loading
   control_utils::Pid::Gains get_controller_pid();
   std::vector<std::string> get_controller_joints();
 
   // Callbacks
   void desired_position_subscrition_callback(ros2_control_interfaces::msg::JointControl::UniquePtr msg);
+  void indexed_command_subscription_callback(ros2_control_interfaces::msg::IndexedJointControl::UniquePtr msg);
+  void pid_parameters_callback(ros2_control_interfaces::msg::PidParameters::UniquePtr msg);
+
+  // The per cycle control law of update() for N joints, N = 0 for any number. Realtime.
+  template <std::size_t N>
+  controller_interface::controller_interface_ret_t
+  update_joints(const JointReference &reference, const rclcpp::Time &timeNow, const rclcpp::Duration &timeElapsed);
+
+  // Reads the reference handles into handle_reference_. The stamp is renewed when the reference starts moving.
+  const JointReference &read_reference_handles(int64_t now_ns);
+
+  // Extrapolates pending_reference_ to stamp_ns in feedforward mode, and restamps it
+  void advance_pending_reference(int64_t stamp_ns);
+
+  // Adds errors_ to the tracking statistics, a reference with a new stamp starts a new segment. Realtime.
+  void track_errors(int64_t now_ns, int64_t reference_stamp_ns, bool at_goal);
+  void publish_tracking_stats();
 
   // Nodegroup namespace
   std::string namespace_;
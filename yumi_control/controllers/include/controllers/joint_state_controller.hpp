@@ -27,6 +27,8 @@
 
 #include "controllers/visibility_control.h"
 
+#include "ros2_control_utils/realtime_publisher.hpp"
+
 #include "sensor_msgs/msg/joint_state.hpp"
 
 
@@ -39,6 +41,10 @@ public:
   ROS_CONTROLLERS_PUBLIC
   JointStateController(); 
 
+  ROS_CONTROLLERS_PUBLIC
+  controller_interface::controller_interface_ret_t
+  init(std::weak_ptr<hardware_interface::RobotHardware> robot_hardware, const std::string & controller_name) override;
+
   ROS_CONTROLLERS_PUBLIC
   controller_interface::controller_interface_ret_t
   update() override;
@@ -50,7 +56,14 @@ public:
 private:
   std::vector<const hardware_interface::JointStateHandle *> registered_joint_handles_;
   std::shared_ptr<rclcpp_lifecycle::LifecyclePublisher<sensor_msgs::msg::JointState>> joint_state_publisher_;
-  sensor_msgs::msg::JointState joint_state_msg_;
+  // Publishes off the control thread, a cycle is skipped if the previous state is still being published
+  std::unique_ptr<control_utils::RealtimePublisher<sensor_msgs::msg::JointState>> realtime_publisher_;
+  rclcpp::Clock::SharedPtr clock_;
+
+  // Decimation, the state is published at publish_rate, at most once per cycle. 0 publishes every cycle.
+  double publish_rate_ = 0.0;
+  int64_t publish_period_ns_ = 0;
+  int64_t next_publish_ns_ = 0;
 
   // Nodegroup namespace
   std::string namespace_;
@@ -14,18 +14,33 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
+#include "control_msgs/action/follow_joint_trajectory.hpp"
 #include "controller_interface/controller_interface.hpp"
+#include "geometry_msgs/msg/wrench_stamped.hpp"
 #include "hardware_interface/operation_mode_handle.hpp"
 #include "hardware_interface/robot_hardware.hpp"
+#include "rclcpp_action/rclcpp_action.hpp"
+#include "rclcpp_lifecycle/lifecycle_publisher.hpp"
 #include "rclcpp_lifecycle/state.hpp"
+#include <controllers/command_claims.hpp>
+#include <controllers/online_trajectory_generator.hpp>
+#include <controllers/tracking_error_stats.hpp>
 #include <controllers/trajectory.hpp>
 #include <controllers/visibility_control.h>
+#include "sensor_msgs/msg/joint_state.hpp"
 #include "trajectory_msgs/msg/joint_trajectory.hpp"
 #include "trajectory_msgs/msg/joint_trajectory_point.hpp"
 #include <std_msgs/msg/bool.hpp>
+#include <std_msgs/msg/float64.hpp>
+#include "ros2_control_interfaces/msg/indexed_joint_control.hpp"
+#include "ros2_control_interfaces/msg/trajectory_start.hpp"
+#include "ros2_control_utils/realtime_buffer.hpp"
+#include "ros2_control_utils/realtime_queue.hpp"
 
 
 namespace ros_controllers
@@ -74,32 +89,303 @@ public:
   on_shutdown(const rclcpp_lifecycle::State & previous_state) override;
 
 private:
+  using FollowJointTrajectory = control_msgs::action::FollowJointTrajectory;
+  using GoalHandle = rclcpp_action::ServerGoalHandle<FollowJointTrajectory>;
+
+  // State of the control loop, handed from update() to the action monitor every cycle
+  struct ControllerState
+  {
+    const Trajectory * trajectory = nullptr;  // Identifies the sampled trajectory, never dereferenced
+    int64_t time_ns = 0;                      // On the trajectory clock
+    std::vector<double> desired_positions;
+    std::vector<double> desired_velocities;
+    std::vector<double> actual_positions;
+    std::vector<double> actual_velocities;
+    std::vector<double> peak_position_errors;  // Largest |error| of each joint while the trajectory was executed
+    control_utils::TrackingSummary tracking;   // Tracking error statistics of the trajectory, on the wall clock
+
+    void resize(size_t dof)
+    {
+      desired_positions.assign(dof, 0.0);
+      desired_velocities.assign(dof, 0.0);
+      actual_positions.assign(dof, 0.0);
+      actual_velocities.assign(dof, 0.0);
+      peak_position_errors.assign(dof, 0.0);
+    }
+  };
+
+  // A FollowJointTrajectory goal being executed, with its tolerances resolved per joint
+  struct ActiveGoal
+  {
+    std::shared_ptr<GoalHandle> handle;
+    std::shared_ptr<Trajectory> trajectory;
+    std::vector<double> path_tolerances;  // [rad], infinity if unchecked
+    std::vector<double> goal_tolerances;  // [rad], infinity if unchecked
+    int64_t goal_time_tolerance_ns = 0;
+    std::shared_ptr<FollowJointTrajectory::Feedback> feedback;
+  };
+  // error_code of a goal aborted through no fault of its own: preempted, replaced, stopped, taken over by another
+  // controller or the controller deactivated or reset. Below the control_msgs error codes.
+  static constexpr int32_t GOAL_PREEMPTED = -10;
+
+  // Joint state when a contact stopped the motion, handed from update() to the timer
+  struct ContactState
+  {
+    const Trajectory * trajectory = nullptr;  // Stopped trajectory, nullptr when servoing. Never dereferenced
+    int64_t stamp_ns = 0;                     // On the wall clock
+    std::vector<double> positions;
+    std::vector<double> velocities;
+  };
+
+  using IndexedJointControl = ros2_control_interfaces::msg::IndexedJointControl;
+  using TrajectoryStart = ros2_control_interfaces::msg::TrajectoryStart;
+
+  // A start exchanged with the peer controller, on the wall clock
+  struct StartReport
+  {
+    int64_t received_ns = 0;
+    int64_t stamp_ns = 0;
+    int64_t started_ns = 0;  // 0 until started
+  };
+
+  // The trajectory of the latest synchronized start, kept to compile it again if the peer starts later
+  struct PendingStart
+  {
+    std::shared_ptr<trajectory_msgs::msg::JointTrajectory> msg;
+    std::shared_ptr<Trajectory> previous;    // Spliced onto, nullptr if started from the current state
+    std::shared_ptr<Trajectory> trajectory;  // As published
+    int64_t received_ns = 0;
+    int64_t stamp_ns = 0;
+  };
+
+  // A streamed servo setpoint
+  struct ServoPoint
+  {
+    int64_t time_ns = 0;  // Wall clock time the point is to be reached
+    std::array<double, IndexedJointControl::MAX_JOINTS> positions{};
+    std::array<double, IndexedJointControl::MAX_JOINTS> velocities{};  // Tangents of the interpolation
+  };
+  // Latest streamed target
+  struct TargetPoint
+  {
+    int64_t stamp_ns = 0;  // Wall clock time of the target
+    std::array<double, IndexedJointControl::MAX_JOINTS> positions{};
+    std::array<double, IndexedJointControl::MAX_JOINTS> velocities{};  // The target moves on at these
+  };
+  static constexpr size_t SERVO_QUEUE_SIZE = 32;
+  // Marks the halves of a plan that start in sync with the peer
+  static constexpr const char * SYNC_START_FRAME_ID = "both_arms";
+  // Trajectories in use at a time: the three buffer slots, the published one, the one of an action goal, the one
+  // being compiled and the two of a pending synchronized start
+  static constexpr size_t TRAJECTORY_POOL_SIZE = 10;
+
   std::vector<std::string> joint_names_;
   std::vector<std::string> write_op_names_;
 
+  // "position" commands the joints directly. "reference" writes the <joint>_ref and <joint>_ref_vel handles instead,
+  // for a joint_position_controller chained after this controller to close the loop on.
+  std::string command_interface_ = "position";
   std::vector<hardware_interface::JointCommandHandle *> registered_joint_cmd_handles_;
   std::vector<hardware_interface::JointCommandHandle *> registered_joint_vel_cmd_handles_;
+  std::vector<hardware_interface::JointCommandHandle *> claim_handles_;  // Empty without command arbitration
   std::vector<const hardware_interface::JointStateHandle *> registered_joint_state_handles_;
   std::vector<hardware_interface::OperationModeHandle *> registered_operation_mode_handles_;
 
   bool subscriber_is_active_ = false;
   rclcpp::Subscription<trajectory_msgs::msg::JointTrajectory>::SharedPtr joint_command_subscriber_ = nullptr;
   rclcpp::Subscription<std_msgs::msg::Bool>::SharedPtr stop_command_subscriber_;
+  rclcpp::Subscription<std_msgs::msg::Float64>::SharedPtr speed_scaling_subscriber_;
+  rclcpp::Subscription<IndexedJointControl>::SharedPtr servo_subscriber_;
+  rclcpp::Subscription<IndexedJointControl>::SharedPtr target_subscriber_;
+
+  // Sample of the active trajectory, written every cycle by update()
+  TrajectoryState sampled_state_;
+  // Joint state the next received trajectory starts from, only used by the subscription callback
+  TrajectoryState start_state_;
 
-  TrajectoryPointConstIter prev_traj_point_ptr_;
-  std::shared_ptr<Trajectory> * traj_point_active_ptr_ = nullptr;
-  std::shared_ptr<Trajectory> traj_external_point_ptr_ = nullptr;
-  std::shared_ptr<Trajectory> traj_home_point_ptr_ = nullptr;
+  // Trajectories are compiled in the subscription callback and handed to update() without locking. A published
+  // trajectory is never modified, and the last reference to it is always dropped by the publishing side, so update()
+  // neither blocks nor frees memory. published_trajectory_ is the publishing side's copy of the latest one.
+  control_utils::RealtimeBuffer<std::shared_ptr<Trajectory>> trajectory_buffer_;
+  std::shared_ptr<Trajectory> published_trajectory_ = nullptr;
+  // Received trajectories are validated against limits_ and compiled into trajectories of the pool
+  TrajectoryLimits limits_;
+  TrajectoryPool trajectory_pool_;
+  size_t max_trajectory_points_ = 1000;
   std::shared_ptr<trajectory_msgs::msg::JointTrajectory> traj_msg_home_ptr_ = nullptr;
 
+  // Online speed override. Trajectories are timed on a trajectory clock that update() advances by speed_scale_ times
+  // the cycle time, so scaling changes the progress along the active trajectory without replanning it. speed_scale_
+  // follows the target with bounded rate and acceleration, which bounds the jerk the change adds to the motion.
+  // The offset of the trajectory clock from the wall clock is published for the subscription callbacks.
+  std::atomic<double> target_speed_scale_{1.0};
+  std::atomic<int64_t> trajectory_clock_offset_ns_{0};
+  double speed_scale_ = 1.0;
+  double speed_scale_rate_ = 0.0;
+  double clock_offset_ns_ = 0.0;
+  int64_t last_update_ns_ = 0;
+  double max_speed_scale_ = 1.0;
+  double speed_scale_max_rate_ = 1.0;          // [1/s]
+  double speed_scale_max_acceleration_ = 4.0;  // [1/s^2]
+
+  // FollowJointTrajectory action. The control loop only publishes its state, tolerances are checked and feedback is
+  // sent by a timer on the executor, at action_monitor_rate. Path errors are tracked by update() at the control rate.
+  rclcpp_action::Server<FollowJointTrajectory>::SharedPtr action_server_;
+  rclcpp::TimerBase::SharedPtr action_monitor_timer_;
+  std::shared_ptr<ActiveGoal> active_goal_;
+  control_utils::RealtimeBuffer<ControllerState> state_buffer_;
+  ControllerState rt_state_;
+  double action_monitor_rate_ = 50.0;        // [Hz]
+  double default_path_tolerance_ = 0.0;      // [rad], 0 for unchecked
+  double default_goal_tolerance_ = 0.01;     // [rad], 0 for unchecked
+  double default_goal_time_tolerance_ = 0.5; // [s]
+
+  // Tracking error statistics of every executed trajectory, computed by update() and published on ~/tracking_error
+  // at tracking_stats_rate. The statistics of a goal are also added to its result.
+  control_utils::TrackingStatistics tracking_statistics_;
+  control_utils::TrackingStatistics::JointArray tracking_errors_ = {};
+  std::shared_ptr<rclcpp_lifecycle::LifecyclePublisher<ros2_control_interfaces::msg::TrackingErrorStats>> 
+    tracking_publisher_;
+  rclcpp::TimerBase::SharedPtr tracking_timer_;
+  ros2_control_interfaces::msg::TrackingErrorStats tracking_msg_;
+  double settling_tolerance_ = 0.01; // [rad]
+  double tracking_stats_rate_ = 1.0; // [Hz]
+
+  // Servo input. Setpoints streamed on ~/servo are delayed by servo_delay_ns_ and queued without locking, update()
+  // interpolates them with cubic Hermite segments. When the stream stops the last setpoint is held. Servoing replaces
+  // trajectory execution until the next trajectory is received.
+  control_utils::RealtimeQueue<ServoPoint, SERVO_QUEUE_SIZE> servo_queue_;
+  std::atomic<bool> servo_active_{false};
+  uint32_t joint_order_hash_ = 0;
+  int64_t servo_delay_ns_ = 8000000;
+  bool servo_use_velocities_ = false;
+  // Segment being interpolated, owned by update()
+  bool servo_running_ = false;
+  bool servo_holding_ = true;
+  ServoPoint servo_prev_;
+  ServoPoint servo_next_;
+
+  // Target input. Targets streamed on ~/target replace each other, only the latest one is followed. update() moves
+  // the joints towards it with the online trajectory generator, which takes over a new target from the current
+  // position, velocity and acceleration within the jerk limit, so a target can change in any cycle, e.g. to chase a
+  // moving object. A target velocity extrapolates the target for up to target_extrapolation after its stamp.
+  // Following targets replaces trajectory execution and servoing until the next trajectory or setpoint is received.
+  control_utils::RealtimeBuffer<TargetPoint> target_buffer_;
+  std::atomic<bool> target_active_{false};
+  OnlineTrajectoryGenerator target_generator_;
+  // Owned by update(), target_start_ is the preallocated joint state the generator takes over from
+  TrajectoryState target_start_;
+  bool target_running_ = false;
+  int64_t target_last_ns_ = 0;
+  bool trajectory_sampled_ = false;  // sampled_state_ holds the accelerations of the last cycle
+  // Ended with the joints settled, its last point is no longer written and the commands are released. Owned by update()
+  const Trajectory * settled_trajectory_ = nullptr;
+  // Given up by update() as another controller took the joints over, not followed again. Cleared by a new trajectory.
+  std::atomic<const Trajectory *> taken_trajectory_{nullptr};
+  double target_max_velocity_ = 1.0;      // [rad/s]
+  double target_max_acceleration_ = 2.0;  // [rad/s^2]
+  double target_max_jerk_ = 20.0;         // [rad/s^3]
+  double target_extrapolation_ = 0.1;     // [s]
+
+  // Smooth stop. Without a trajectory or setpoints to follow update() decelerates the joints from their commanded
+  // velocity to rest, within stop_acceleration_ and stop_jerk_. The stop state is published on ~/stopped.
+  enum StopState : uint8_t
+  {
+    MOVING,
+    STOPPING,
+    STOPPED
+  };
+  std::atomic<uint8_t> stop_state_{MOVING};
+  bool stop_profile_active_ = false;
+  int64_t stop_start_ns_ = 0;
+  double stop_duration_ = 0.0;
+  bool stop_profile_written_ = false;  // The end of the profile was commanded, the hardware holds it from then on
+  std::vector<double> stop_positions_;
+  std::vector<double> stop_velocities_;
+  double stop_acceleration_ = 2.0;           // [rad/s^2]
+  double stop_jerk_ = 20.0;                  // [rad/s^3]
+  double stopped_velocity_threshold_ = 0.01; // [rad/s]
+  std::shared_ptr<rclcpp_lifecycle::LifecyclePublisher<std_msgs::msg::Bool>> stopped_publisher_;
+  std::atomic<int> published_stop_state_{-1};
+
+  // Synchronized start with the start_sync_peer controller, e.g. the one of the other arm. A trajectory without a
+  // stamp whose header.frame_id is SYNC_START_FRAME_ID, i.e. one half of a both_arms plan, starts start_delay after it
+  // is received, and its start is exchanged with the peer on ~/trajectory_start. Other trajectories start as before.
+  // Halves of a plan received by both controllers within start_sync_window start together, at the later of the two
+  // starts. update() reports the first cycle at or after the start, and the skew to the peer's first cycle is
+  // published on ~/start_skew.
+  std::shared_ptr<rclcpp_lifecycle::LifecyclePublisher<TrajectoryStart>> start_publisher_;
+  std::shared_ptr<rclcpp_lifecycle::LifecyclePublisher<std_msgs::msg::Float64>> start_skew_publisher_;
+  rclcpp::Subscription<TrajectoryStart>::SharedPtr start_sync_subscriber_;
+  PendingStart pending_start_;
+  StartReport peer_start_;
+  StartReport peer_started_;
+  StartReport own_started_;
+  std::atomic<int64_t> sync_start_ns_{0};    // Pending start on the trajectory clock, 0 if none
+  std::atomic<int64_t> sync_started_ns_{0};  // Wall clock time update() reached it, 0 until then
+  int64_t start_delay_ns_ = 50000000;
+  int64_t start_sync_window_ns_ = 30000000;
+
+  // Contact guard. Wrenches from ExternalForce and external joint torques from ETorqueReceiver are compared with the
+  // thresholds as they arrive, and a crossing stops the motion in the next update(): the trajectory or servo stream is
+  // left, the joints decelerate to rest, an active goal is aborted and the joint state at contact is published on
+  // ~/contact. The guard is cleared by the next trajectory or a stop on ~/arm_stop.
+  rclcpp::Subscription<geometry_msgs::msg::WrenchStamped>::SharedPtr wrench_subscriber_;
+  rclcpp::Subscription<sensor_msgs::msg::JointState>::SharedPtr external_torque_subscriber_;
+  rclcpp::Subscription<std_msgs::msg::Float64>::SharedPtr contact_force_threshold_subscriber_;
+  std::shared_ptr<rclcpp_lifecycle::LifecyclePublisher<sensor_msgs::msg::JointState>> contact_publisher_;
+  std::atomic<double> contact_force_threshold_{0.0};  // [N], 0 for unguarded
+  std::vector<double> contact_torque_thresholds_;      // [Nm] in joint order, empty for unguarded
+  bool force_above_threshold_ = false;
+  bool torque_above_threshold_ = false;
+  std::atomic<bool> contact_detected_{false};
+  std::atomic<bool> contact_stop_{false};
+  ContactState rt_contact_;
+  control_utils::RealtimeBuffer<ContactState> contact_buffer_;
+  std::atomic<uint32_t> contact_count_{0};
+  uint32_t reported_contact_count_ = 0;
+
   bool is_halted = false;
-  bool is_stopped = false;
-  bool new_trajectory = false;
+  std::atomic<bool> is_stopped{false};
+  std::atomic<bool> new_trajectory{false};
 
   bool reset();
   void set_op_mode(const hardware_interface::OperationMode & mode);
   void halt();
+  void publish_trajectory(std::shared_ptr<Trajectory> trajectory);
+  std::shared_ptr<Trajectory> execute_trajectory(std::shared_ptr<trajectory_msgs::msg::JointTrajectory> msg);
+  std::shared_ptr<Trajectory> compile_trajectory(std::shared_ptr<trajectory_msgs::msg::JointTrajectory> msg,
+                                                 const std::shared_ptr<Trajectory> & previous);
+  void publish_state(const Trajectory & trajectory, int64_t time_ns, int64_t now_ns);
+  void publish_tracking_stats(const control_utils::TrackingSummary & summary);
+
+  rclcpp_action::GoalResponse handle_goal(const rclcpp_action::GoalUUID & uuid,
+                                          std::shared_ptr<const FollowJointTrajectory::Goal> goal);
+  rclcpp_action::CancelResponse handle_cancel(const std::shared_ptr<GoalHandle> goal_handle);
+  void handle_accepted(const std::shared_ptr<GoalHandle> goal_handle);
+  void monitor_active_goal();
+  void finish_active_goal(bool success, int32_t error_code, const std::string & error_string);
+  std::string describe_tracking(const control_utils::TrackingSummary & summary) const;
+  std::vector<double> resolve_tolerances(const std::vector<control_msgs::msg::JointTolerance> & tolerances,
+                                         double default_tolerance) const;
   void stop_command_callback(std_msgs::msg::Bool::UniquePtr msg);
+  void speed_scaling_callback(std_msgs::msg::Float64::UniquePtr msg);
+  void servo_command_callback(IndexedJointControl::UniquePtr msg);
+  void sample_servo(int64_t now_ns);
+  void target_command_callback(IndexedJointControl::UniquePtr msg);
+  void sample_target(int64_t now_ns);
+  void stop_motion(int64_t now_ns);
+  void publish_stop_state();
+  void wrench_callback(geometry_msgs::msg::WrenchStamped::UniquePtr msg);
+  void external_torque_callback(sensor_msgs::msg::JointState::UniquePtr msg);
+  void record_contact(const Trajectory * trajectory, int64_t now_ns);
+  void publish_contact();
+  void start_sync_callback(TrajectoryStart::UniquePtr msg);
+  void publish_start(const StartReport & start);
+  void publish_started();
+  void report_start_skew();
+  void advance_trajectory_clock(int64_t now_ns);
+  rclcpp::Time to_trajectory_time(const rclcpp::Time & wall_time) const;
 };
 
 }  // namespace ros_controllers
\ No newline at end of file
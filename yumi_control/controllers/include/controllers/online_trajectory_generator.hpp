@@ -0,0 +1,75 @@
+// Copyright 2020 Markus Bjønnes and Marius Nilsen.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <vector>
+#include <controllers/trajectory.hpp>
+
+
+namespace ros_controllers
+{
+
+/**
+ * @brief Jerk limited motion of every joint towards a target, which may change in any cycle.
+ *
+ * Each update() advances the joints by one cycle from their position, velocity and acceleration, so a new target is
+ * taken over smoothly mid-motion without replanning. The jerk of each joint is chosen by a cascade: the velocity
+ * from which the joint can still brake onto the target, then the acceleration that reaches this velocity once the
+ * acceleration is ramped down. Far from the target the joints move at the limits, near it the cascade turns linear,
+ * so they settle without overshoot or chattering. This costs time against a time-optimal profile: the cascade brakes
+ * early and ends on an exponential approach, e.g. 1 rad at 1 rad/s, 2 rad/s^2 and 20 rad/s^3 settles within 1e-4 rad
+ * after 2.04 s in 4 ms cycles, against 1.6 s time optimally. A target velocity is matched once the target is reached,
+ * for following a moving target.
+ *
+ * The joints move independently, each as fast as its own limits allow. Nothing is allocated after resize().
+ */
+class OnlineTrajectoryGenerator
+{
+public:
+  void resize(size_t dof);
+
+  /**
+   * @brief Sets the limits of the motion.
+   *
+   * Targets are clamped to the position limits. The velocity of a joint is limited by max_velocity, and by its
+   * limit in limits.max_velocities if given. Empty limits are not checked.
+   */
+  void set_limits(const TrajectoryLimits & limits, double max_velocity, double max_acceleration, double max_jerk);
+
+  /* Starts from the given joint state, in joint order. The targets are set to the positions, at rest. */
+  void reset(const std::vector<double> & positions, const std::vector<double> & velocities,
+             const std::vector<double> & accelerations);
+
+  void set_target(size_t joint, double position, double velocity);
+
+  /* Advances the joints by dt towards their targets. */
+  void update(double dt);
+
+  const TrajectoryState & state() const { return state_; }
+
+private:
+  double braking_velocity(double distance) const;
+
+  TrajectoryState state_;
+  std::vector<double> target_positions_;
+  std::vector<double> target_velocities_;
+  std::vector<double> min_positions_;
+  std::vector<double> max_positions_;
+  std::vector<double> max_velocities_;
+  double max_acceleration_ = 2.0;  // [rad/s^2]
+  double max_jerk_ = 20.0;         // [rad/s^3]
+};
+
+}  // namespace ros_controllers
@@ -0,0 +1,36 @@
+#ifndef ROS_CONTROLLERS__TRACKING_ERROR_STATS_HPP_
+#define ROS_CONTROLLERS__TRACKING_ERROR_STATS_HPP_
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "rclcpp/time.hpp"
+#include "ros2_control_interfaces/msg/tracking_error_stats.hpp"
+#include "ros2_control_utils/tracking_statistics.hpp"
+
+
+namespace ros_controllers
+{
+
+/* Fills msg with summary, for the first summary.size of joint_names. Non realtime, the msg arrays are resized. */
+inline void
+to_tracking_error_stats(const control_utils::TrackingSummary & summary, const std::vector<std::string> & joint_names,
+                        ros2_control_interfaces::msg::TrackingErrorStats & msg)
+{
+  size_t joint_num = std::min(summary.size, joint_names.size());
+  msg.stamp = rclcpp::Time(summary.start_ns);
+  msg.segment = summary.segment;
+  msg.joint_names.assign(joint_names.begin(), joint_names.begin() + joint_num);
+  msg.samples = static_cast<uint32_t>(summary.samples);
+  msg.duration = (summary.last_sample_ns - summary.start_ns) * 1e-9;
+  msg.goal_time = summary.goal_ns < 0 ? -1.0 : (summary.goal_ns - summary.start_ns) * 1e-9;
+  msg.rms_error.assign(summary.rms_error.begin(), summary.rms_error.begin() + joint_num);
+  msg.max_error.assign(summary.max_error.begin(), summary.max_error.begin() + joint_num);
+  msg.goal_error.assign(summary.goal_error.begin(), summary.goal_error.begin() + joint_num);
+  msg.settling_time.assign(summary.settling_time.begin(), summary.settling_time.begin() + joint_num);
+}
+
+}  // namespace ros_controllers
+
+#endif  // ROS_CONTROLLERS__TRACKING_ERROR_STATS_HPP_
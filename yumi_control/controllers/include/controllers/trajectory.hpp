@@ -1,7 +1,9 @@
 #ifndef ROS_CONTROLLERS__TRAJECTORY_HPP_
 #define ROS_CONTROLLERS__TRAJECTORY_HPP_
 
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "rclcpp/time.hpp"
@@ -13,61 +15,195 @@
 namespace ros_controllers
 {
 
-using TrajectoryPointIter = std::vector<trajectory_msgs::msg::JointTrajectoryPoint>::iterator;
-using TrajectoryPointConstIter = std::vector<trajectory_msgs::msg::JointTrajectoryPoint>::const_iterator;
+/* Position, velocity and acceleration of every joint, in trajectory joint order. */
+struct TrajectoryState
+{
+  std::vector<double> positions;
+  std::vector<double> velocities;
+  std::vector<double> accelerations;
+
+  void resize(size_t dof)
+  {
+    positions.assign(dof, 0.0);
+    velocities.assign(dof, 0.0);
+    accelerations.assign(dof, 0.0);
+  }
+};
+
+/* Joint limits received trajectories are checked against, in controller joint order. Empty vectors are unchecked. */
+struct TrajectoryLimits
+{
+  std::vector<double> min_positions;
+  std::vector<double> max_positions;
+  std::vector<double> max_velocities;
+};
 
+enum class TrajectoryValidation
+{
+  VALID,
+  INVALID_JOINTS,
+  INVALID_POINTS
+};
+
+/* validate_trajectory : Checks a received trajectory before it is compiled, and puts it in controller joint order.
+*
+* The msg must name each of joint_names exactly once, in any order. Every point needs a position per joint, velocities
+* and accelerations are optional but complete if given, and all values finite. time_from_start must increase strictly
+* from point to point. Positions, given velocities and the mean velocity between consecutive points must be within
+* limits.
+* On success validated holds the msg reordered to joint_names, otherwise error describes the first violation.
+*/
+ROS_CONTROLLERS_PUBLIC
+TrajectoryValidation
+validate_trajectory(const trajectory_msgs::msg::JointTrajectory & joint_trajectory,
+                    const std::vector<std::string> & joint_names, const TrajectoryLimits & limits,
+                    trajectory_msgs::msg::JointTrajectory & validated, std::string & error);
+
+/* A joint trajectory compiled to piecewise polynomials.
+*
+* A JointTrajectory msg is compiled once, off the control thread, into a segment table: one polynomial per segment
+* and joint, with knot times in integer nanoseconds. The polynomial order follows the data in the msg: quintic if
+* every point has accelerations, cubic if every point has velocities, else linear. Segments from knots that are not
+* msg points, such as the current state, are quintic. The derivatives the msg leaves out at the point ending such a
+* segment are those of the segment after it, so velocity and acceleration are continuous there as well.
+*
+* Coefficients are stored as structure-of-arrays, segment by segment and order by order with the joints contiguous,
+* so evaluating a sample touches one contiguous block and runs the same loop for every joint.
+*/
 class Trajectory
 {
 public:
+  static constexpr size_t COEFFICIENTS = 6;        /**< Coefficients per polynomial, up to quintic. */
+  static constexpr int64_t MIN_SEGMENT_NS = 100000;  /**< Knots closer to the previous one are skipped. */
+
   ROS_CONTROLLERS_PUBLIC
   Trajectory();
 
   ROS_CONTROLLERS_PUBLIC
   explicit Trajectory(std::shared_ptr<trajectory_msgs::msg::JointTrajectory> joint_trajectory);
 
+  /* Compiles the msg. The trajectory starts at header.stamp, or now if the stamp is zero. */
   ROS_CONTROLLERS_PUBLIC
-  void 
+  void
   update(std::shared_ptr<trajectory_msgs::msg::JointTrajectory> joint_trajectory);
 
-  /* sample : Find the next valid point from the containing trajectory msg.
+  /* Compiles the msg with current_state as the first knot, at the start time of the trajectory.
   *
-  * Within each msg, points with time_from_start less or equal than current time will be skipped.
-  * 
-  * The first point with time_from_start greater than current time shall be a valid point,
-  * Return end iterator if start time of desired trajectory msg is in the future
-  * Else within each msg, valid point is the first point in the the msg with expected arrival time
-  * in the future.
-  * 
-  * Arrival time is time_from_start of point + start time of msg
-  * If an empty trajectory message is given, sample will return Trajectory::end()
-  * If no valid point is found for the specified sample time, Trajectory::end() will be returned.
+  * Points arriving less than MIN_SEGMENT_NS after the previous knot are skipped, so a first point with zero
+  * time_from_start is replaced by the current state and the motion starts from where the joints actually are.
   */
   ROS_CONTROLLERS_PUBLIC
-  TrajectoryPointConstIter
-  sample(const rclcpp::Time & sample_time);
+  void
+  update(std::shared_ptr<trajectory_msgs::msg::JointTrajectory> joint_trajectory,
+         const TrajectoryState & current_state);
 
+  /* Compiles the msg as a replacement of previous, which is being executed, following the ROS trajectory
+  * replacement semantics.
+  *
+  * The first knot is the state of previous at now, so position, velocity and acceleration are continuous. If the msg
+  * starts in the future, previous is followed until then: its knots up to the start time are copied, and a knot at
+  * the start time is taken from it. Points of the msg that arrive before now are dropped.
+  * If previous is empty or has not started yet at now, current_state is used as for update(msg, current_state).
+  * All times, now and header.stamp included, are on the clock previous is sampled with.
+  *
+  * Only the const sample_at() is used on previous, so it may be sampled by the control thread meanwhile.
+  */
   ROS_CONTROLLERS_PUBLIC
-  TrajectoryPointConstIter
-  begin() const;
+  void
+  update(std::shared_ptr<trajectory_msgs::msg::JointTrajectory> joint_trajectory,
+         const Trajectory & previous, const TrajectoryState & current_state, const rclcpp::Time & now);
+
+  /* sample : Evaluates position, velocity and acceleration of every joint at sample_time.
+  *
+  * Keeps a cursor to the segment of the previous sample, so sampling with increasing times, as the control loop does,
+  * is O(1) amortized. Going back in time restarts the search from the first segment.
+  *
+  * After the last knot the last point is held with zero velocity and acceleration.
+  * Returns false, and leaves state untouched, if the trajectory is empty or sample_time is before its start.
+  * state must already be sized for dof() joints, no memory is allocated.
+  */
+  ROS_CONTROLLERS_PUBLIC
+  bool
+  sample(const rclcpp::Time & sample_time, TrajectoryState & state);
 
+  /* Same as sample() but without the cursor, with a binary search for the segment. */
   ROS_CONTROLLERS_PUBLIC
-  TrajectoryPointConstIter
-  end() const;
+  bool
+  sample_at(const rclcpp::Time & sample_time, TrajectoryState & state) const;
 
+  /* Start time of the trajectory, the time of the first knot. */
   ROS_CONTROLLERS_PUBLIC
   rclcpp::Time
   time_from_start() const;
 
+  /* Time of the last knot. */
+  ROS_CONTROLLERS_PUBLIC
+  rclcpp::Time
+  end_time() const;
+
   ROS_CONTROLLERS_PUBLIC
   bool
   is_empty() const;
 
+  ROS_CONTROLLERS_PUBLIC
+  size_t
+  dof() const { return dof_; }
+
+  ROS_CONTROLLERS_PUBLIC
+  size_t
+  segment_count() const { return knot_ns_.empty() ? 0 : knot_ns_.size() - 1; }
+
+  /* Reserves memory for trajectories of up to knots knots, so compiling them does not allocate. */
+  ROS_CONTROLLERS_PUBLIC
+  void
+  reserve(size_t dof, size_t knots);
+
 private:
-  std::shared_ptr<trajectory_msgs::msg::JointTrajectory> trajectory_msg_;
+  size_t dof_ = 0;
+  size_t cursor_ = 0;
+  int64_t start_ns_ = 0;
+
+  // knot_ns_[s] is the start of segment s, the last entry the end of the trajectory.
+  std::vector<int64_t> knot_ns_;
+  // coefficients_[(s * COEFFICIENTS + k) * dof_ + j] is the k-th order coefficient of joint j in segment s,
+  // in local segment time [s].
+  std::vector<double> coefficients_;
+  // Last knot, held after the end.
+  std::vector<double> end_positions_;
+  // Scratch for compile(), the state of every knot and how much of it is known
+  std::vector<double> knot_positions_;
+  std::vector<double> knot_velocities_;
+  std::vector<double> knot_accelerations_;
+  std::vector<int> knot_detail_;
+
+  int64_t start_time_ns(const trajectory_msgs::msg::JointTrajectory & joint_trajectory, int64_t now_ns) const;
+  void compile(const trajectory_msgs::msg::JointTrajectory & joint_trajectory, int64_t start_ns,
+               const std::vector<int64_t> & prefix_ns, const std::vector<TrajectoryState> & prefix_states);
+  void evaluate(size_t segment, int64_t time_ns, TrajectoryState & state) const;
+  void hold_end(TrajectoryState & state) const;
+};
 
-  rclcpp::Time trajectory_start_time_;
+/* A fixed set of trajectories allocated up front and reused.
+*
+* A trajectory is free again once only the pool holds it. As the pool keeps a reference to every trajectory, none is
+* ever freed by the control thread letting go of it.
+*/
+class TrajectoryPool
+{
+public:
+  ROS_CONTROLLERS_PUBLIC
+  void
+  allocate(size_t size, size_t dof, size_t max_points);
+
+  /* A trajectory no one else holds, or nullptr if all are in use. */
+  ROS_CONTROLLERS_PUBLIC
+  std::shared_ptr<Trajectory>
+  acquire();
+
+private:
+  std::vector<std::shared_ptr<Trajectory>> trajectories_;
 };
 
 }  // namespace ros_controllers
 
-#endif  // ROS_CONTROLLERS__TRAJECTORY_HPP_
\ No newline at end of file
+#endif  // ROS_CONTROLLERS__TRAJECTORY_HPP_
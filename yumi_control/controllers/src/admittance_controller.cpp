@@ -0,0 +1,420 @@
+// Copyright 2020 Markus Bjønnes and Marius Nilsen.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <memory>
+#include <vector>
+
+#include <controllers/admittance_controller.hpp>
+#include "lifecycle_msgs/msg/state.hpp"
+#include "rclcpp/time.hpp"
+
+
+/* Admittance controller, making the TCP of an arm compliant to external forces, e.g. for lead-through programming.
+
+  The TCP wrench is estimated in the control loop from the external joint torques of the robot controller, as
+  (J J^T)^-1 J tau, the same estimate yumi_dynamics publishes, without the topic hops in between. The wrench drives a
+  virtual mass-damper-spring per Cartesian axis, whose velocity is mapped to joint velocities with the damped least
+  squares inverse of the Jacobian and integrated into position commands within the joint limits.
+
+  The controller is enabled and disabled on ~/enable. While disabled, or without recent torques, the joints are
+  decelerated to rest and the commands are left to the other controllers, so it is loaded after them.
+*/
+
+namespace ros_controllers
+{
+
+using controller_interface::CONTROLLER_INTERFACE_RET_SUCCESS;
+using lifecycle_msgs::msg::State;
+
+namespace
+{
+
+// Shrinks the magnitude of the 3 vector at offset by deadband, so small estimation errors do not move the arm
+void apply_deadband(CartesianKinematics::Vector6 & wrench, int offset, double deadband)
+{
+  double magnitude = wrench.segment<3>(offset).norm();
+  wrench.segment<3>(offset) *= magnitude > deadband ? (magnitude - deadband) / magnitude : 0.0;
+}
+
+// Scales the 3 vector at offset down to max_norm
+void clamp_norm(CartesianKinematics::Vector6 & vector, int offset, double max_norm)
+{
+  double norm = vector.segment<3>(offset).norm();
+  if (norm > max_norm)
+  {
+    vector.segment<3>(offset) *= max_norm / norm;
+  }
+}
+
+}  // namespace
+
+AdmittanceController::AdmittanceController()
+: controller_interface::ControllerInterface()
+{}
+
+controller_interface::controller_interface_ret_t
+AdmittanceController::init(std::weak_ptr<hardware_interface::RobotHardware> robot_hardware,
+                           const std::string & controller_name)
+{
+  auto ret = ControllerInterface::init(robot_hardware, controller_name);
+  if (ret != CONTROLLER_INTERFACE_RET_SUCCESS)
+  {
+    return ret;
+  }
+  clock_ = lifecycle_node_->get_clock();
+
+  lifecycle_node_->declare_parameter<std::vector<std::string>>("joints", {});
+  lifecycle_node_->declare_parameter<std::vector<std::string>>("write_op_modes", {});
+  lifecycle_node_->declare_parameter<std::string>("command_interface", command_interface_);
+  lifecycle_node_->declare_parameter<std::string>("robot_description_path", "");
+  lifecycle_node_->declare_parameter<std::string>("planning_component", "");
+  lifecycle_node_->declare_parameter<std::string>("external_torque_topic", "");
+  lifecycle_node_->declare_parameter<std::vector<double>>("mass", {2.0, 2.0, 2.0, 0.05, 0.05, 0.05});
+  lifecycle_node_->declare_parameter<std::vector<double>>("damping", {40.0, 40.0, 40.0, 2.0, 2.0, 2.0});
+  lifecycle_node_->declare_parameter<std::vector<double>>("stiffness", {0.0, 0.0, 0.0, 0.0, 0.0, 0.0});
+  lifecycle_node_->declare_parameter<double>("force_deadband", force_deadband_);
+  lifecycle_node_->declare_parameter<double>("torque_deadband", torque_deadband_);
+  lifecycle_node_->declare_parameter<double>("torque_timeout", torque_timeout_);
+  lifecycle_node_->declare_parameter<double>("max_linear_velocity", max_linear_velocity_);
+  lifecycle_node_->declare_parameter<double>("max_angular_velocity", max_angular_velocity_);
+  lifecycle_node_->declare_parameter<double>("max_joint_acceleration", limits_.max_acceleration);
+  lifecycle_node_->declare_parameter<double>("singularity_damping", singularity_damping_);
+  lifecycle_node_->declare_parameter<std::vector<double>>("position_limits_lower", {});
+  lifecycle_node_->declare_parameter<std::vector<double>>("position_limits_upper", {});
+  lifecycle_node_->declare_parameter<std::vector<double>>("velocity_limits", {});
+
+  return CONTROLLER_INTERFACE_RET_SUCCESS;
+}
+
+controller_interface::controller_interface_ret_t
+AdmittanceController::update()
+{
+  if (lifecycle_node_->get_current_state().id() == State::PRIMARY_STATE_INACTIVE)
+  {
+    admittance_state_ = IDLE;
+    last_update_ns_ = 0;
+    set_claims(claim_handles_, COMMAND_RELEASE);
+    return CONTROLLER_INTERFACE_RET_SUCCESS;
+  }
+
+  int64_t now_ns = clock_->now().nanoseconds();
+  double dt = last_update_ns_ > 0 ? (now_ns - last_update_ns_) * 1e-9 : 0.0;
+  last_update_ns_ = now_ns;
+
+  // Latest torques, never blocks on the subscription callback
+  const auto & sample = torque_buffer_.read_from_rt();
+  bool compliant = enabled_ && sample.stamp_ns > 0 && (now_ns - sample.stamp_ns) * 1e-9 <= torque_timeout_;
+  bool taken = admittance_state_ != IDLE && claims_taken(claim_handles_);
+  if (admittance_state_ == IDLE || taken)
+  {
+    if (!compliant && !taken)
+    {
+      return CONTROLLER_INTERFACE_RET_SUCCESS;
+    }
+
+    // Anchored where the controller that commanded the joints until now left them, also when one of higher priority
+    // took them over
+    for (size_t index = 0; index < registered_joint_cmd_handles_.size(); ++index)
+    {
+      commanded_positions_[index] = registered_joint_cmd_handles_[index]->get_cmd();
+      commanded_velocities_[index] = registered_joint_vel_cmd_handles_[index]->get_cmd();
+    }
+    displacement_.setZero();
+    velocity_.setZero();
+    admittance_state_ = COMPLIANT;
+  }
+  if (dt <= 0.0)
+  {
+    return CONTROLLER_INTERFACE_RET_SUCCESS;
+  }
+
+  std::fill(desired_velocities_.begin(), desired_velocities_.end(), 0.0);
+  if (compliant && kinematics_.update(commanded_positions_))
+  {
+    admittance_state_ = COMPLIANT;
+    for (size_t index = 0; index < torques_.size(); ++index)
+    {
+      torques_[index] = sample.torques[index];
+    }
+    Vector6 wrench = kinematics_.torques_to_wrench(torques_, singularity_damping_);
+    apply_deadband(wrench, 0, force_deadband_);
+    apply_deadband(wrench, 3, torque_deadband_);
+
+    // Semi-implicit Euler step of M a + D v + K x = F
+    Vector6 acceleration = (wrench - damping_.cwiseProduct(velocity_) - stiffness_.cwiseProduct(displacement_))
+      .cwiseQuotient(mass_);
+    velocity_ += acceleration * dt;
+    clamp_norm(velocity_, 0, max_linear_velocity_);
+    clamp_norm(velocity_, 3, max_angular_velocity_);
+    displacement_ += velocity_ * dt;
+
+    kinematics_.twist_to_joint_velocities(velocity_, singularity_damping_, desired_velocities_);
+  }
+  else
+  {
+    admittance_state_ = DECELERATING;
+    velocity_.setZero();
+  }
+
+  bool at_rest = integrate_joint_velocities(limits_, desired_velocities_, dt, commanded_positions_,
+    commanded_velocities_);
+  for (size_t index = 0; index < registered_joint_cmd_handles_.size(); ++index)
+  {
+    registered_joint_cmd_handles_[index]->set_cmd(commanded_positions_[index]);
+    registered_joint_vel_cmd_handles_[index]->set_cmd(commanded_velocities_[index]);
+  }
+  set_op_mode(hardware_interface::OperationMode::ACTIVE);
+
+  // The last command is held by the hardware, and the joints are handed back to controllers of lower priority
+  if (admittance_state_ == DECELERATING && at_rest)
+  {
+    admittance_state_ = IDLE;
+    set_claims(claim_handles_, COMMAND_RELEASE);
+  }
+  else
+  {
+    set_claims(claim_handles_, COMMAND_CLAIM);
+  }
+
+  return CONTROLLER_INTERFACE_RET_SUCCESS;
+}
+
+rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
+AdmittanceController::on_configure(const rclcpp_lifecycle::State & previous_state)
+{
+  (void) previous_state;
+  auto logger = lifecycle_node_->get_logger();
+  reset();
+
+  joint_names_ = lifecycle_node_->get_parameter("joints").as_string_array();
+  write_op_names_ = lifecycle_node_->get_parameter("write_op_modes").as_string_array();
+  command_interface_ = lifecycle_node_->get_parameter("command_interface").as_string();
+  if (command_interface_ != "position" && command_interface_ != "reference")
+  {
+    RCLCPP_ERROR(logger, "command_interface must be position or reference, not %s", command_interface_.c_str());
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+  if (joint_names_.empty() || joint_names_.size() > MAX_JOINTS)
+  {
+    RCLCPP_ERROR(logger, "between 1 and %zu joints are supported", MAX_JOINTS);
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+
+  // Virtual dynamics, the mass must be positive and the damping and stiffness not negative
+  const char * names[] = {"mass", "damping", "stiffness"};
+  Vector6 * values[] = {&mass_, &damping_, &stiffness_};
+  for (size_t i = 0; i < 3; ++i)
+  {
+    auto parameter = lifecycle_node_->get_parameter(names[i]).as_double_array();
+    if (parameter.size() != 6)
+    {
+      RCLCPP_ERROR(logger, "%s must be given for x y z rx ry rz", names[i]);
+      return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+    }
+    *values[i] = Eigen::Map<const Vector6>(parameter.data());
+  }
+  if ((mass_.array() <= 0.0).any() || (damping_.array() < 0.0).any() || (stiffness_.array() < 0.0).any())
+  {
+    RCLCPP_ERROR(logger, "mass must be positive, damping and stiffness must not be negative");
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+
+  force_deadband_ = std::max(lifecycle_node_->get_parameter("force_deadband").as_double(), 0.0);
+  torque_deadband_ = std::max(lifecycle_node_->get_parameter("torque_deadband").as_double(), 0.0);
+  torque_timeout_ = lifecycle_node_->get_parameter("torque_timeout").as_double();
+  max_linear_velocity_ = std::max(lifecycle_node_->get_parameter("max_linear_velocity").as_double(), 0.0);
+  max_angular_velocity_ = std::max(lifecycle_node_->get_parameter("max_angular_velocity").as_double(), 0.0);
+  limits_.max_acceleration = lifecycle_node_->get_parameter("max_joint_acceleration").as_double();
+  singularity_damping_ = lifecycle_node_->get_parameter("singularity_damping").as_double();
+  if (torque_timeout_ <= 0.0 || limits_.max_acceleration <= 0.0 || singularity_damping_ <= 0.0)
+  {
+    RCLCPP_ERROR(logger, "torque_timeout, max_joint_acceleration and singularity_damping must be positive");
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+  limits_.min_positions = lifecycle_node_->get_parameter("position_limits_lower").as_double_array();
+  limits_.max_positions = lifecycle_node_->get_parameter("position_limits_upper").as_double_array();
+  limits_.max_velocities = lifecycle_node_->get_parameter("velocity_limits").as_double_array();
+  for (const auto * limits : {&limits_.min_positions, &limits_.max_positions, &limits_.max_velocities})
+  {
+    if (!limits->empty() && limits->size() != joint_names_.size())
+    {
+      RCLCPP_ERROR(logger, "joint limits must be empty or given for each of the %zu joints", joint_names_.size());
+      return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+    }
+  }
+  if (limits_.min_positions.size() != limits_.max_positions.size())
+  {
+    RCLCPP_ERROR(logger, "position_limits_lower and position_limits_upper must both be given");
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+
+  std::string error;
+  if (!kinematics_.init(lifecycle_node_->get_parameter("robot_description_path").as_string(),
+                        lifecycle_node_->get_parameter("planning_component").as_string(), joint_names_, error))
+  {
+    RCLCPP_ERROR(logger, "%s", error.c_str());
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+
+  if (auto robot_hardware = robot_hardware_.lock())
+  {
+    std::string suffix = command_interface_ == "reference" ? "_ref" : "";
+    std::vector<std::string> cmd_names;
+    registered_joint_cmd_handles_.resize(joint_names_.size());
+    registered_joint_vel_cmd_handles_.resize(joint_names_.size());
+    for (size_t index = 0; index < joint_names_.size(); ++index)
+    {
+      auto cmd_name = joint_names_[index] + suffix;
+      cmd_names.push_back(cmd_name);
+      if (robot_hardware->get_joint_command_handle(cmd_name.c_str(), &registered_joint_cmd_handles_[index])
+          != hardware_interface::HW_RET_OK ||
+          robot_hardware->get_joint_command_handle((cmd_name + "_vel").c_str(),
+            &registered_joint_vel_cmd_handles_[index]) != hardware_interface::HW_RET_OK)
+      {
+        RCLCPP_WARN(logger, "unable to obtain joint command handles for %s", cmd_name.c_str());
+        return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::FAILURE;
+      }
+    }
+    claim_handles_ = get_claim_handles(*robot_hardware, cmd_names);
+    registered_operation_mode_handles_.resize(write_op_names_.size());
+    for (size_t index = 0; index < write_op_names_.size(); ++index)
+    {
+      auto ret = robot_hardware->get_operation_mode_handle(write_op_names_[index].c_str(),
+        &registered_operation_mode_handles_[index]);
+      if (ret != hardware_interface::HW_RET_OK)
+      {
+        RCLCPP_WARN(logger, "unable to obtain operation mode handle for %s", write_op_names_[index].c_str());
+        return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::FAILURE;
+      }
+    }
+  }
+  else
+  {
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+
+  commanded_positions_.assign(joint_names_.size(), 0.0);
+  commanded_velocities_.assign(joint_names_.size(), 0.0);
+  desired_velocities_.assign(joint_names_.size(), 0.0);
+  torques_.assign(joint_names_.size(), 0.0);
+  torque_buffer_.initialize(TorqueSample());
+  admittance_state_ = IDLE;
+  enabled_ = false;
+
+  // Without external torques the joints are only held, e.g. on an arm whose torques are not published
+  auto external_torque_topic = lifecycle_node_->get_parameter("external_torque_topic").as_string();
+  if (external_torque_topic.empty())
+  {
+    RCLCPP_WARN(logger, "No external_torque_topic, admittance control is unavailable");
+  }
+  else
+  {
+    external_torque_subscriber_ = lifecycle_node_->create_subscription<sensor_msgs::msg::JointState>(
+      external_torque_topic, rclcpp::SensorDataQoS(),
+      std::bind(&AdmittanceController::external_torque_callback, this, std::placeholders::_1));
+  }
+  enable_subscriber_ = lifecycle_node_->create_subscription<std_msgs::msg::Bool>("~/enable",
+    rclcpp::SystemDefaultsQoS(),
+    [this](std_msgs::msg::Bool::UniquePtr msg)
+    {
+      if (msg->data && !external_torque_subscriber_)
+      {
+        RCLCPP_WARN(lifecycle_node_->get_logger(), "admittance control is unavailable without external torques");
+      }
+      enabled_ = subscriber_is_active_ && msg->data && external_torque_subscriber_;
+      RCLCPP_INFO(lifecycle_node_->get_logger(), "admittance control %s", enabled_ ? "enabled" : "disabled");
+    });
+
+  return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
+}
+
+rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
+AdmittanceController::on_activate(const rclcpp_lifecycle::State & previous_state)
+{
+  (void) previous_state;
+  subscriber_is_active_ = true;
+  return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
+}
+
+rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
+AdmittanceController::on_deactivate(const rclcpp_lifecycle::State & previous_state)
+{
+  (void) previous_state;
+  subscriber_is_active_ = false;
+  enabled_ = false;
+  return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
+}
+
+rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
+AdmittanceController::on_cleanup(const rclcpp_lifecycle::State & previous_state)
+{
+  (void) previous_state;
+  reset();
+  return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
+}
+
+void
+AdmittanceController::external_torque_callback(sensor_msgs::msg::JointState::UniquePtr msg)
+{
+  // Torques in controller joint order, as sent by the robot controller
+  if (msg->effort.size() < joint_names_.size())
+  {
+    return;
+  }
+  TorqueSample sample;
+  for (size_t index = 0; index < joint_names_.size(); ++index)
+  {
+    if (!std::isfinite(msg->effort[index]))
+    {
+      return;
+    }
+    sample.torques[index] = msg->effort[index];
+  }
+
+  // Timed on reception, so a sender with another clock is not taken as stale
+  sample.stamp_ns = clock_->now().nanoseconds();
+  torque_buffer_.write_from_non_rt(sample);
+}
+
+void
+AdmittanceController::set_op_mode(const hardware_interface::OperationMode & mode)
+{
+  for (auto & op_mode_handle : registered_operation_mode_handles_)
+  {
+    op_mode_handle->set_mode(mode);
+  }
+}
+
+void
+AdmittanceController::reset()
+{
+  subscriber_is_active_ = false;
+  enabled_ = false;
+  external_torque_subscriber_.reset();
+  enable_subscriber_.reset();
+  registered_joint_cmd_handles_.clear();
+  registered_joint_vel_cmd_handles_.clear();
+  claim_handles_.clear();
+  registered_operation_mode_handles_.clear();
+  admittance_state_ = IDLE;
+}
+
+}  // namespace ros_controllers
+
+#include "class_loader/register_macro.hpp"
+
+CLASS_LOADER_REGISTER_CLASS(ros_controllers::AdmittanceController, controller_interface::ControllerInterface)
@@ -0,0 +1,172 @@
+// Copyright 2020 Markus Bjønnes and Marius Nilsen.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+#include <controllers/cartesian_kinematics.hpp>
+#include <Eigen/Cholesky>
+#include <kdl_wrapper/kdl_wrapper.h>
+#include <urdf/model.h>
+
+
+namespace ros_controllers
+{
+
+bool
+CartesianKinematics::init(const std::string & urdf_path, const std::string & planning_component,
+                          const std::vector<std::string> & joint_names, std::string & error)
+{
+  jacobian_solver_.reset();
+  chain_joints_.clear();
+
+  urdf::Model robot_model;
+  if (!robot_model.initFile(urdf_path))
+  {
+    error = "unable to load urdf " + urdf_path;
+    return false;
+  }
+  KdlWrapper kdl_wrapper(robot_model);
+  if (!kdl_wrapper.init())
+  {
+    error = "kdl wrapper failed to initialize";
+    return false;
+  }
+  if (planning_component == "left_arm")
+  {
+    chain_ = kdl_wrapper.get_left_arm();
+  }
+  else if (planning_component == "right_arm")
+  {
+    chain_ = kdl_wrapper.get_right_arm();
+  }
+  else
+  {
+    error = "planning_component must be left_arm or right_arm, not " + planning_component;
+    return false;
+  }
+
+  // Every joint of the chain must be controlled, in whatever order
+  for (unsigned int segment = 0; segment < chain_.getNrOfSegments(); ++segment)
+  {
+    const auto & joint = chain_.getSegment(segment).getJoint();
+    if (joint.getType() == KDL::Joint::None)
+    {
+      continue;
+    }
+    auto found = std::find(joint_names.begin(), joint_names.end(), joint.getName());
+    if (found == joint_names.end())
+    {
+      error = "joint " + joint.getName() + " of the " + planning_component + " chain is not controlled";
+      return false;
+    }
+    chain_joints_.push_back(static_cast<size_t>(std::distance(joint_names.begin(), found)));
+  }
+
+  jacobian_solver_ = std::make_unique<KDL::ChainJntToJacSolver>(chain_);
+  chain_positions_.resize(chain_.getNrOfJoints());
+  jacobian_.resize(chain_.getNrOfJoints());
+  chain_vector_.setZero(chain_.getNrOfJoints());
+  return true;
+}
+
+bool
+CartesianKinematics::update(const std::vector<double> & positions)
+{
+  for (size_t i = 0; i < chain_joints_.size(); ++i)
+  {
+    chain_positions_(i) = positions[chain_joints_[i]];
+  }
+  return jacobian_solver_ && jacobian_solver_->JntToJac(chain_positions_, jacobian_) >= 0;
+}
+
+CartesianKinematics::Vector6
+CartesianKinematics::damped_solve(const Vector6 & vector, double damping) const
+{
+  Eigen::Matrix<double, 6, 6> damped;
+  damped.noalias() = jacobian_.data * jacobian_.data.transpose();
+  damped.diagonal().array() += damping * damping;
+  return damped.ldlt().solve(vector);
+}
+
+void
+CartesianKinematics::twist_to_joint_velocities(const Vector6 & twist, double damping, std::vector<double> & velocities)
+{
+  Vector6 weights = damped_solve(twist, damping);
+  chain_vector_.noalias() = jacobian_.data.transpose() * weights;
+  std::fill(velocities.begin(), velocities.end(), 0.0);
+  for (size_t i = 0; i < chain_joints_.size(); ++i)
+  {
+    velocities[chain_joints_[i]] = chain_vector_(i);
+  }
+}
+
+CartesianKinematics::Vector6
+CartesianKinematics::torques_to_wrench(const std::vector<double> & torques, double damping)
+{
+  for (size_t i = 0; i < chain_joints_.size(); ++i)
+  {
+    chain_vector_(i) = torques[chain_joints_[i]];
+  }
+  Vector6 projected;
+  projected.noalias() = jacobian_.data * chain_vector_;
+  return damped_solve(projected, damping);
+}
+
+bool
+integrate_joint_velocities(const JointMotionLimits & limits, std::vector<double> & desired_velocities, double dt,
+                           std::vector<double> & positions, std::vector<double> & velocities)
+{
+  size_t joint_num = positions.size();
+  double scale = 1.0;
+  for (size_t index = 0; index < limits.max_velocities.size(); ++index)
+  {
+    double speed = std::abs(desired_velocities[index]);
+    if (speed > limits.max_velocities[index])
+    {
+      scale = std::min(scale, limits.max_velocities[index] / speed);
+    }
+  }
+  double max_change = limits.max_acceleration * dt;
+  double change_scale = 1.0;
+  for (size_t index = 0; index < joint_num; ++index)
+  {
+    desired_velocities[index] *= scale;
+    double change = std::abs(desired_velocities[index] - velocities[index]);
+    if (change > max_change)
+    {
+      change_scale = std::min(change_scale, max_change / change);
+    }
+  }
+
+  bool at_rest = true;
+  for (size_t index = 0; index < joint_num; ++index)
+  {
+    double velocity = velocities[index] + change_scale * (desired_velocities[index] - velocities[index]);
+    double position = positions[index] + velocity * dt;
+    if (!limits.min_positions.empty() &&
+        (position < limits.min_positions[index] || position > limits.max_positions[index]))
+    {
+      position = std::min(std::max(position, limits.min_positions[index]), limits.max_positions[index]);
+      velocity = 0.0;
+    }
+    positions[index] = position;
+    velocities[index] = velocity;
+    at_rest = at_rest && velocity == 0.0;
+  }
+  return at_rest;
+}
+
+}  // namespace ros_controllers
@@ -0,0 +1,350 @@
+// Copyright 2020 Markus Bjønnes and Marius Nilsen.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <memory>
+#include <vector>
+
+#include <controllers/cartesian_velocity_controller.hpp>
+#include "lifecycle_msgs/msg/state.hpp"
+#include "rclcpp/time.hpp"
+
+
+/* Controller servoing the TCP of an arm to a commanded twist, for small closed-loop corrections at control rate.
+
+  Twists are streamed on ~/twist, linear [m/s] and angular [rad/s] velocity of the tip of the arm chain, expressed in
+  the base frame of the chain. Every cycle the twist is mapped to joint velocities with the damped least squares
+  inverse of the Jacobian, qdot = J^T (J J^T + damping^2 I)^-1 v, which stays bounded near singularities. The joint
+  velocities are scaled down together to the joint velocity and acceleration limits, so the TCP keeps its direction,
+  and are integrated into position commands within the position limits.
+
+  When no twist has been received for twist_timeout the joints are decelerated to rest, and the controller stops
+  writing commands. The last command is then held until another controller writes, so this controller is loaded
+  after the joint_trajectory_controller, and overrides it while a twist is being streamed.
+*/
+
+namespace ros_controllers
+{
+
+using controller_interface::CONTROLLER_INTERFACE_RET_SUCCESS;
+using lifecycle_msgs::msg::State;
+
+CartesianVelocityController::CartesianVelocityController()
+: controller_interface::ControllerInterface()
+{}
+
+controller_interface::controller_interface_ret_t
+CartesianVelocityController::init(std::weak_ptr<hardware_interface::RobotHardware> robot_hardware,
+                                  const std::string & controller_name)
+{
+  auto ret = ControllerInterface::init(robot_hardware, controller_name);
+  if (ret != CONTROLLER_INTERFACE_RET_SUCCESS)
+  {
+    return ret;
+  }
+  clock_ = lifecycle_node_->get_clock();
+
+  lifecycle_node_->declare_parameter<std::vector<std::string>>("joints", {});
+  lifecycle_node_->declare_parameter<std::vector<std::string>>("write_op_modes", {});
+  lifecycle_node_->declare_parameter<std::string>("command_interface", command_interface_);
+  lifecycle_node_->declare_parameter<std::string>("robot_description_path", "");
+  lifecycle_node_->declare_parameter<std::string>("planning_component", "");
+  lifecycle_node_->declare_parameter<double>("damping", damping_);
+  lifecycle_node_->declare_parameter<double>("twist_timeout", twist_timeout_);
+  lifecycle_node_->declare_parameter<double>("max_linear_velocity", max_linear_velocity_);
+  lifecycle_node_->declare_parameter<double>("max_angular_velocity", max_angular_velocity_);
+  lifecycle_node_->declare_parameter<double>("max_joint_acceleration", limits_.max_acceleration);
+  lifecycle_node_->declare_parameter<std::vector<double>>("position_limits_lower", {});
+  lifecycle_node_->declare_parameter<std::vector<double>>("position_limits_upper", {});
+  lifecycle_node_->declare_parameter<std::vector<double>>("velocity_limits", {});
+
+  return CONTROLLER_INTERFACE_RET_SUCCESS;
+}
+
+controller_interface::controller_interface_ret_t
+CartesianVelocityController::update()
+{
+  if (lifecycle_node_->get_current_state().id() == State::PRIMARY_STATE_INACTIVE)
+  {
+    servo_state_ = IDLE;
+    last_update_ns_ = 0;
+    set_claims(claim_handles_, COMMAND_RELEASE);
+    return CONTROLLER_INTERFACE_RET_SUCCESS;
+  }
+
+  int64_t now_ns = clock_->now().nanoseconds();
+  double dt = last_update_ns_ > 0 ? (now_ns - last_update_ns_) * 1e-9 : 0.0;
+  last_update_ns_ = now_ns;
+
+  // Latest twist, never blocks on the subscription callback
+  const auto & command = twist_buffer_.read_from_rt();
+  bool fresh = command.stamp_ns > 0 && (now_ns - command.stamp_ns) * 1e-9 <= twist_timeout_;
+  if (servo_state_ != IDLE && claims_taken(claim_handles_))
+  {
+    // Taken over by a controller of higher priority, e.g. the admittance_controller, servo on from where it leaves them
+    for (size_t index = 0; index < registered_joint_cmd_handles_.size(); ++index)
+    {
+      commanded_positions_[index] = registered_joint_cmd_handles_[index]->get_cmd();
+      commanded_velocities_[index] = registered_joint_vel_cmd_handles_[index]->get_cmd();
+    }
+  }
+  if (servo_state_ == IDLE)
+  {
+    if (!fresh)
+    {
+      return CONTROLLER_INTERFACE_RET_SUCCESS;
+    }
+
+    // Start from the commanded state of the controller that commanded the joints until now
+    for (size_t index = 0; index < registered_joint_cmd_handles_.size(); ++index)
+    {
+      commanded_positions_[index] = registered_joint_cmd_handles_[index]->get_cmd();
+      commanded_velocities_[index] = registered_joint_vel_cmd_handles_[index]->get_cmd();
+    }
+    servo_state_ = SERVOING;
+  }
+  if (dt <= 0.0)
+  {
+    return CONTROLLER_INTERFACE_RET_SUCCESS;
+  }
+  servo_state_ = fresh ? SERVOING : DECELERATING;
+
+  // Joint velocities of the twist, from the damped least squares inverse of the Jacobian at the commanded positions
+  std::fill(desired_velocities_.begin(), desired_velocities_.end(), 0.0);
+  if (fresh && kinematics_.update(commanded_positions_))
+  {
+    kinematics_.twist_to_joint_velocities(
+      Eigen::Map<const CartesianKinematics::Vector6>(command.twist.data()), damping_, desired_velocities_);
+  }
+
+  bool at_rest = integrate_joint_velocities(limits_, desired_velocities_, dt, commanded_positions_, 
+    commanded_velocities_);
+  for (size_t index = 0; index < registered_joint_cmd_handles_.size(); ++index)
+  {
+    registered_joint_cmd_handles_[index]->set_cmd(commanded_positions_[index]);
+    registered_joint_vel_cmd_handles_[index]->set_cmd(commanded_velocities_[index]);
+  }
+  set_op_mode(hardware_interface::OperationMode::ACTIVE);
+
+  // The last command is held by the hardware, and the joints are handed back to controllers of lower priority
+  if (servo_state_ == DECELERATING && at_rest)
+  {
+    servo_state_ = IDLE;
+    set_claims(claim_handles_, COMMAND_RELEASE);
+  }
+  else
+  {
+    set_claims(claim_handles_, COMMAND_CLAIM);
+  }
+
+  return CONTROLLER_INTERFACE_RET_SUCCESS;
+}
+
+rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
+CartesianVelocityController::on_configure(const rclcpp_lifecycle::State & previous_state)
+{
+  (void) previous_state;
+  auto logger = lifecycle_node_->get_logger();
+  reset();
+
+  joint_names_ = lifecycle_node_->get_parameter("joints").as_string_array();
+  write_op_names_ = lifecycle_node_->get_parameter("write_op_modes").as_string_array();
+  command_interface_ = lifecycle_node_->get_parameter("command_interface").as_string();
+  if (command_interface_ != "position" && command_interface_ != "reference")
+  {
+    RCLCPP_ERROR(logger, "command_interface must be position or reference, not %s", command_interface_.c_str());
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+  damping_ = lifecycle_node_->get_parameter("damping").as_double();
+  twist_timeout_ = lifecycle_node_->get_parameter("twist_timeout").as_double();
+  max_linear_velocity_ = lifecycle_node_->get_parameter("max_linear_velocity").as_double();
+  max_angular_velocity_ = lifecycle_node_->get_parameter("max_angular_velocity").as_double();
+  limits_.max_acceleration = lifecycle_node_->get_parameter("max_joint_acceleration").as_double();
+  if (damping_ <= 0.0 || twist_timeout_ <= 0.0 || max_linear_velocity_ < 0.0 || max_angular_velocity_ < 0.0 ||
+      limits_.max_acceleration <= 0.0)
+  {
+    RCLCPP_ERROR(logger, "damping, twist_timeout and max_joint_acceleration must be positive, "
+      "max_linear_velocity and max_angular_velocity must not be negative");
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+  limits_.min_positions = lifecycle_node_->get_parameter("position_limits_lower").as_double_array();
+  limits_.max_positions = lifecycle_node_->get_parameter("position_limits_upper").as_double_array();
+  limits_.max_velocities = lifecycle_node_->get_parameter("velocity_limits").as_double_array();
+  for (const auto * limits : {&limits_.min_positions, &limits_.max_positions, &limits_.max_velocities})
+  {
+    if (!limits->empty() && limits->size() != joint_names_.size())
+    {
+      RCLCPP_ERROR(logger, "joint limits must be empty or given for each of the %zu joints", joint_names_.size());
+      return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+    }
+  }
+  if (limits_.min_positions.size() != limits_.max_positions.size())
+  {
+    RCLCPP_ERROR(logger, "position_limits_lower and position_limits_upper must both be given");
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+
+  std::string error;
+  if (!kinematics_.init(lifecycle_node_->get_parameter("robot_description_path").as_string(),
+                        lifecycle_node_->get_parameter("planning_component").as_string(), joint_names_, error))
+  {
+    RCLCPP_ERROR(logger, "%s", error.c_str());
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+
+  if (auto robot_hardware = robot_hardware_.lock())
+  {
+    std::string suffix = command_interface_ == "reference" ? "_ref" : "";
+    std::vector<std::string> cmd_names;
+    registered_joint_cmd_handles_.resize(joint_names_.size());
+    registered_joint_vel_cmd_handles_.resize(joint_names_.size());
+    for (size_t index = 0; index < joint_names_.size(); ++index)
+    {
+      auto cmd_name = joint_names_[index] + suffix;
+      cmd_names.push_back(cmd_name);
+      if (robot_hardware->get_joint_command_handle(cmd_name.c_str(), &registered_joint_cmd_handles_[index])
+          != hardware_interface::HW_RET_OK ||
+          robot_hardware->get_joint_command_handle((cmd_name + "_vel").c_str(), 
+            &registered_joint_vel_cmd_handles_[index]) != hardware_interface::HW_RET_OK)
+      {
+        RCLCPP_WARN(logger, "unable to obtain joint command handles for %s", cmd_name.c_str());
+        return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::FAILURE;
+      }
+    }
+    claim_handles_ = get_claim_handles(*robot_hardware, cmd_names);
+    registered_operation_mode_handles_.resize(write_op_names_.size());
+    for (size_t index = 0; index < write_op_names_.size(); ++index)
+    {
+      auto ret = robot_hardware->get_operation_mode_handle(write_op_names_[index].c_str(),
+        &registered_operation_mode_handles_[index]);
+      if (ret != hardware_interface::HW_RET_OK)
+      {
+        RCLCPP_WARN(logger, "unable to obtain operation mode handle for %s", write_op_names_[index].c_str());
+        return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::FAILURE;
+      }
+    }
+  }
+  else
+  {
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+  if (registered_joint_cmd_handles_.empty())
+  {
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+
+  commanded_positions_.assign(joint_names_.size(), 0.0);
+  commanded_velocities_.assign(joint_names_.size(), 0.0);
+  desired_velocities_.assign(joint_names_.size(), 0.0);
+  twist_buffer_.initialize(TwistCommand());
+  servo_state_ = IDLE;
+
+  twist_subscriber_ = lifecycle_node_->create_subscription<geometry_msgs::msg::TwistStamped>("~/twist",
+    rclcpp::SensorDataQoS(),
+    std::bind(&CartesianVelocityController::twist_callback, this, std::placeholders::_1));
+
+  return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
+}
+
+rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
+CartesianVelocityController::on_activate(const rclcpp_lifecycle::State & previous_state)
+{
+  (void) previous_state;
+  twist_buffer_.write_from_non_rt(TwistCommand());
+  subscriber_is_active_ = true;
+  return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
+}
+
+rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
+CartesianVelocityController::on_deactivate(const rclcpp_lifecycle::State & previous_state)
+{
+  (void) previous_state;
+  subscriber_is_active_ = false;
+  return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
+}
+
+rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
+CartesianVelocityController::on_cleanup(const rclcpp_lifecycle::State & previous_state)
+{
+  (void) previous_state;
+  reset();
+  return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
+}
+
+void
+CartesianVelocityController::twist_callback(geometry_msgs::msg::TwistStamped::UniquePtr msg)
+{
+  if (!subscriber_is_active_)
+  {
+    return;
+  }
+  TwistCommand command;
+  command.twist = {msg->twist.linear.x, msg->twist.linear.y, msg->twist.linear.z,
+                   msg->twist.angular.x, msg->twist.angular.y, msg->twist.angular.z};
+  for (double value : command.twist)
+  {
+    if (!std::isfinite(value))
+    {
+      RCLCPP_WARN(lifecycle_node_->get_logger(), "twist with non finite values ignored");
+      return;
+    }
+  }
+
+  // Clamp the linear and angular speed, keeping the direction
+  double linear = std::sqrt(command.twist[0] * command.twist[0] + command.twist[1] * command.twist[1] +
+                            command.twist[2] * command.twist[2]);
+  double angular = std::sqrt(command.twist[3] * command.twist[3] + command.twist[4] * command.twist[4] +
+                             command.twist[5] * command.twist[5]);
+  double linear_scale = linear > max_linear_velocity_ ? max_linear_velocity_ / linear : 1.0;
+  double angular_scale = angular > max_angular_velocity_ ? max_angular_velocity_ / angular : 1.0;
+  for (size_t i = 0; i < 3; ++i)
+  {
+    command.twist[i] *= linear_scale;
+    command.twist[i + 3] *= angular_scale;
+  }
+
+  // Timed on reception, so a sender with another clock is not taken as stale
+  command.stamp_ns = clock_->now().nanoseconds();
+  twist_buffer_.write_from_non_rt(command);
+}
+
+void
+CartesianVelocityController::set_op_mode(const hardware_interface::OperationMode & mode)
+{
+  for (auto & op_mode_handle : registered_operation_mode_handles_)
+  {
+    op_mode_handle->set_mode(mode);
+  }
+}
+
+void
+CartesianVelocityController::reset()
+{
+  subscriber_is_active_ = false;
+  twist_subscriber_.reset();
+  registered_joint_cmd_handles_.clear();
+  registered_joint_vel_cmd_handles_.clear();
+  claim_handles_.clear();
+  registered_operation_mode_handles_.clear();
+  servo_state_ = IDLE;
+}
+
+}  // namespace ros_controllers
+
+#include "class_loader/register_macro.hpp"
+
+CLASS_LOADER_REGISTER_CLASS(ros_controllers::CartesianVelocityController, controller_interface::ControllerInterface)
@@ -1,5 +1,7 @@
 #include "controllers/joint_position_controller.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <string>
 #include <sstream>
 #include <random>
@@ -8,6 +10,7 @@
 
 #include <angles/angles.h>
 
+#include "lifecycle_msgs/msg/state.hpp"
 #include "lifecycle_msgs/msg/transition.hpp"
 #include "rclcpp_lifecycle/state.hpp"
 #include "rcutils/logging_macros.h"
@@ -61,6 +64,13 @@ JointPositionController::init(std::weak_ptr<hardware_interface::RobotHardware> r
       return ret;
   }
 
+  // With the lifecycle node initialized, we can declare parameters
+  lifecycle_node_->declare_parameter<bool>("feedforward", feedforward_);
+  lifecycle_node_->declare_parameter<double>("feedforward_horizon", feedforward_horizon_);
+  lifecycle_node_->declare_parameter<std::string>("reference_input", "topic");
+  lifecycle_node_->declare_parameter<double>("settling_tolerance", settling_tolerance_);
+  lifecycle_node_->declare_parameter<double>("tracking_stats_rate", tracking_stats_rate_);
+
   RCLCPP_INFO(this->get_lifecycle_node()->get_logger(), "JointPositionController init() successful");
   return controller_interface::CONTROLLER_INTERFACE_RET_SUCCESS;
 }
@@ -76,66 +86,34 @@ JointPositionController::update()
   //            +-----+
   //    error-->|  P  |-->joint_addition
   //            +-----+
+  //
+  //  In feedforward mode the reference is extrapolated to now, the PID closes the loop on the residual error only:
+  //
+  //                          v_ref, a_ref --> feedforward --+
+  //                                                         v
+  //    p_ref - curr_pos --> error --> PID --> addition --> (+) --> position and velocity cmd
+
+  if (this->get_lifecycle_node()->get_current_state().id() != lifecycle_msgs::msg::State::PRIMARY_STATE_ACTIVE)
+  {
+    return hardware_interface::HW_RET_OK;
+  }
 
   auto timeNow = this->get_lifecycle_node()->get_clock()->now();
   auto timeElapsed = timeNow - previous_update_time_;
   previous_update_time_ = timeNow;
-  auto pos_map = std::map<std::string, double>();
 
-  // populating joint_name + joint_pos map
-  for (auto &state : registered_joint_state_handles_)
-  {
-    pos_map[state->get_name()] = state->get_position();
-  }
+  // Consistent snapshot of the desired motion, never blocks on the subscription callback. Chained, the reference was
+  // sampled by the upstream controller in this cycle.
+  const auto &reference = reference_from_handles_ ?  //if
+    read_reference_handles(timeNow.nanoseconds()) :  //then
+    desired_pos_buffer_.read_from_rt();  //else
 
-  // for every joint:
-  for (size_t i = 0; i < registered_joint_state_handles_.size(); i++)
+  // Every YuMi arm has the same number of joints, for which the per joint loops are compiled with fixed bounds
+  if (registered_joint_cmd_handles_.size() == control_utils::PidBank::YUMI_ARM_JOINTS)
   {
-    auto state_handle = registered_joint_state_handles_[i];
-    auto joint_name = state_handle->get_name();
-    auto curr_pos = state_handle->get_position();
-
-
-    // find_if and utilised lambda function
-    auto fp = [&joint_name](const hardware_interface::JointCommandHandle *cmd_handle) -> bool 
-    { 
-      // return true if its the same joint.
-      return (cmd_handle->get_name().compare(joint_name) == 0); 
-    };
-    auto joint_cmd_iter = 
-      std::find_if(registered_joint_cmd_handles_.cbegin(), registered_joint_cmd_handles_.cend(), fp);
-    
-
-
-    // if joint is to be controlled by this controller
-    if (joint_cmd_iter != registered_joint_cmd_handles_.cend()) 
-    {
-      auto cmd_handle = *joint_cmd_iter;
-      auto desired_pos = desired_pos_map_[joint_name];  
-
-      if(curr_pos != desired_pos)
-      {
-        //--------------PID---------------------------------------------------------------------------------------------
-        auto error = desired_pos - curr_pos;
-        auto addition = pid_controllers_map_[joint_name]->compute_command(error, timeElapsed);
-        // TODO : Replace with proper NaN handling
-        // if(std::isnan(addition))
-        // {
-        //   addition = 0.0;
-        // }
-        // if(std::isnan(curr_pos))
-        // {
-        //   curr_pos = 0.0;
-        // }
-        //--------------------------------------------------------------------------------------------------------------
-        //RCLCPP_INFO_STREAM(this->get_lifecycle_node()->get_logger(), "addition: " << addition);
-        cmd_handle->set_cmd(curr_pos + addition);
-        //cmd_handle->set_cmd(1);
-      }   
-    }
+    return update_joints<control_utils::PidBank::YUMI_ARM_JOINTS>(reference, timeNow, timeElapsed);
   }
-
-  return hardware_interface::HW_RET_OK;
+  return update_joints<0>(reference, timeNow, timeElapsed);
 }
 
 //########################## Callbacks #################################################################################
@@ -144,14 +122,9 @@ void
 JointPositionController::desired_position_subscrition_callback(ros2_control_interfaces::msg::JointControl::UniquePtr msg)
 {
   //  * State:            Active
-  //  * Performs:         Receives incoming msg, populates desired_pos_map_ 
+  //  * Performs:         Receives incoming msg, publishes the desired positions to update() through desired_pos_buffer_
   //  * if unsuccessfull: Prints warning logger message with info about the issue.
 
-  // TODO: Possible optimisation: put this callback in RobotHW instead because most of the data here is not used anyway
-  // However that optimisation will be ugly due to the need to modify the base RobotHW class as there is currently no 
-  // handle for desired pos method
-
-
   auto msg_size = msg->goals.size();                                  
   auto names_size = msg->joints.size();                               
   auto cmd_handle_size = registered_joint_cmd_handles_.size();
@@ -159,31 +132,135 @@ JointPositionController::desired_position_subscrition_callback(ros2_control_inte
   // TODO: Error handling when data don't match expectations
   if (names_size != msg_size)
   {
-    names_size = 0;
     RCLCPP_WARN_ONCE(this->get_lifecycle_node()->get_logger(),
       "Number of joint names do not correspond to number of desired positions. Ignoring data");
     return;
   }
 
+  bool has_velocities = !msg->velocities.empty();
+  bool has_accelerations = !msg->accelerations.empty();
+  if ((has_velocities && msg->velocities.size() != msg_size) || 
+      (has_accelerations && msg->accelerations.size() != msg_size))
+  {
+    RCLCPP_WARN_ONCE(this->get_lifecycle_node()->get_logger(),
+      "Number of desired velocities or accelerations do not correspond to number of desired positions. Ignoring data");
+    return;
+  }
+
+  // A non-finite value would reach EGM through the feedforward term
+  for (size_t i = 0; i < msg_size; i++)
+  {
+    if (!std::isfinite(msg->goals[i]) || (has_velocities && !std::isfinite(msg->velocities[i])) || 
+        (has_accelerations && !std::isfinite(msg->accelerations[i])))
+    {
+      RCLCPP_WARN_ONCE(this->get_lifecycle_node()->get_logger(),
+        "Non-finite desired position, velocity or acceleration. Ignoring data");
+      return;
+    }
+  }
+
   if (msg_size > cmd_handle_size)
   {
     RCLCPP_WARN_ONCE(this->get_lifecycle_node()->get_logger(), 
-      "Subscribed desired position more than robot can handle, adding to map anyway");
+      "Subscribed desired position more than robot can handle, ignoring joints not controlled by this controller");
   }
   else if (msg_size < cmd_handle_size)
   {
     RCLCPP_WARN_ONCE(this->get_lifecycle_node()->get_logger(),
-      "Subscribed desired position less than total joints in robot, ignoring control for joints at the end of the list");
+      "Subscribed desired position less than total joints in robot, keeping previous goal for the remaining joints");
   }
 
-  // Add data to hash table
+  // Bring the joints not present in the msg forward to the new stamp, so that they continue their previous motion
+  advance_pending_reference(this->get_lifecycle_node()->get_clock()->now().nanoseconds());
+
+  // Update the working copy, joints not present in the msg keep their previous goal
   for (size_t i = 0; i < msg_size; i++)
   {
-    auto name = msg->joints[i];
-    auto desired_pos = msg->goals[i];
-    desired_pos_map_[name] = desired_pos;
+    auto index = joint_index_map_.find(msg->joints[i]);
+    if (index == joint_index_map_.end())
+    {
+      RCLCPP_WARN_ONCE(this->get_lifecycle_node()->get_logger(), 
+        "Joint %s is not controlled by this controller, ignoring it", msg->joints[i].c_str());
+      continue;
+    }
+    pending_reference_.positions[index->second] = msg->goals[i];
+    pending_reference_.velocities[index->second] = has_velocities ? msg->velocities[i] : 0.0;
+    pending_reference_.accelerations[index->second] = has_accelerations ? msg->accelerations[i] : 0.0;
   }
 
+  desired_pos_buffer_.write_from_non_rt(pending_reference_);
+}
+
+
+void 
+JointPositionController::indexed_command_subscription_callback(
+  ros2_control_interfaces::msg::IndexedJointControl::UniquePtr msg)
+{
+  //  * State:            Active
+  //  * Performs:         Receives incoming msg in controller joint order, publishes the desired motion to update()
+  //                      through desired_pos_buffer_
+  //  * if unsuccessfull: Prints warning logger message with info about the issue.
+
+  auto joint_num = registered_joint_cmd_handles_.size();
+  if (msg->joint_order_hash != joint_order_hash_ || msg->num_joints != joint_num)
+  {
+    RCLCPP_WARN_ONCE(this->get_lifecycle_node()->get_logger(),
+      "Indexed joint command with joint order hash %u and %u joints does not match this controller (%u, %zu). "
+      "Ignoring data", msg->joint_order_hash, msg->num_joints, joint_order_hash_, joint_num);
+    return;
+  }
+  for (size_t i = 0; i < joint_num; i++)
+  {
+    if (!std::isfinite(msg->goals[i]) || !std::isfinite(msg->velocities[i]) || !std::isfinite(msg->accelerations[i]))
+    {
+      RCLCPP_WARN_ONCE(this->get_lifecycle_node()->get_logger(),
+        "Non-finite indexed joint command. Ignoring data");
+      return;
+    }
+  }
+
+  int64_t msg_stamp_ns = rclcpp::Time(msg->stamp).nanoseconds();
+  if (msg_stamp_ns < last_indexed_stamp_ns_)
+  {
+    return;
+  }
+  last_indexed_stamp_ns_ = msg_stamp_ns;
+
+  pending_reference_.stamp_ns = this->get_lifecycle_node()->get_clock()->now().nanoseconds();
+  for (size_t i = 0; i < joint_num; i++)
+  {
+    pending_reference_.positions[i] = msg->goals[i];
+    pending_reference_.velocities[i] = msg->velocities[i];
+    pending_reference_.accelerations[i] = msg->accelerations[i];
+  }
+
+  desired_pos_buffer_.write_from_non_rt(pending_reference_);
+}
+
+
+void
+JointPositionController::pid_parameters_callback(ros2_control_interfaces::msg::PidParameters::UniquePtr msg)
+{
+  //  * State:            Active
+  //  * Performs:         Hands new gains to update() through the pid bank, for every joint of this controller.
+  //  * if unsuccessfull: Prints warning logger message with info about the issue.
+
+  if (!msg->controller.empty() && msg->controller != this->get_lifecycle_node()->get_name())
+  {
+    return;
+  }
+
+  if (msg->p < 0)
+  {
+    RCLCPP_WARN(this->get_lifecycle_node()->get_logger(), "Negative p gain received, keeping previous gains");
+    return;
+  }
+
+  pid_bank_.set_gains(control_utils::Pid::Gains(msg->p, msg->i, msg->d, msg->i_max, msg->i_min, msg->antiwindup,
+                                                msg->d_cutoff));
+  // Gains may be retuned every cycle, e.g. by the autotune node
+  RCLCPP_DEBUG(this->get_lifecycle_node()->get_logger(), "PID gains updated: p %f, i %f, d %f, d_cutoff %f",
+    msg->p, msg->i, msg->d, msg->d_cutoff);
 }
 
 
@@ -200,6 +277,23 @@ JointPositionController::on_configure(const rclcpp_lifecycle::State &previous_st
 
   (void)previous_state;
   namespace_ =  this->get_lifecycle_node()->get_parameter("namespace").as_string();   //namespacing
+  feedforward_ = lifecycle_node_->get_parameter("feedforward").as_bool();
+  feedforward_horizon_ = lifecycle_node_->get_parameter("feedforward_horizon").as_double();
+  auto reference_input = lifecycle_node_->get_parameter("reference_input").as_string();
+  if (reference_input != "topic" && reference_input != "handles")
+  {
+    RCLCPP_ERROR(this->get_lifecycle_node()->get_logger(), 
+      "reference_input must be topic or handles, not %s. Exiting.", reference_input.c_str());
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+  reference_from_handles_ = reference_input == "handles";
+  settling_tolerance_ = lifecycle_node_->get_parameter("settling_tolerance").as_double();
+  tracking_stats_rate_ = lifecycle_node_->get_parameter("tracking_stats_rate").as_double();
+  if (tracking_stats_rate_ <= 0.0)
+  {
+    RCLCPP_ERROR(this->get_lifecycle_node()->get_logger(), "tracking_stats_rate must be positive. Exiting.");
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
   auto controller_joints = get_controller_joints();   
 
   if (auto sptr = robot_hardware_.lock()) 
@@ -253,14 +347,77 @@ JointPositionController::on_configure(const rclcpp_lifecycle::State &previous_st
       RCLCPP_ERROR(this->get_lifecycle_node()->get_logger(), "0 joint command handles registered. Exiting.");
       return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
     }
+
+    if (registered_joint_cmd_handles_.size() > MAX_CONTROLLER_JOINTS)
+    {
+      RCLCPP_ERROR(this->get_lifecycle_node()->get_logger(), 
+        "%zu joints registered, at most %zu are supported. Exiting.", 
+        registered_joint_cmd_handles_.size(), MAX_CONTROLLER_JOINTS);
+      return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+    }
     //------------------------------------------------------------------------------------------------------------------
 
+    for (size_t index = 0; index < registered_joint_cmd_handles_.size(); ++index)
+    {
+      joint_index_map_[registered_joint_cmd_handles_[index]->get_name()] = index;
+    }
+
+    // Senders of indexed joint commands must use the same joint order
+    std::vector<std::string> joint_order;
+    for (auto handle : registered_joint_cmd_handles_)
+    {
+      joint_order.push_back(handle->get_name());
+    }
+    joint_order_hash_ = control_utils::joint_order_hash(joint_order);
+    joint_names_ = joint_order;
+    RCLCPP_INFO(this->get_lifecycle_node()->get_logger(), "Joint order hash for indexed joint commands: %u", 
+      joint_order_hash_);
+
+    // Chained, the reference is read from the handles an upstream controller writes
+    if (reference_from_handles_)
+    {
+      registered_joint_ref_handles_.resize(registered_joint_cmd_handles_.size());
+      registered_joint_ref_vel_handles_.resize(registered_joint_cmd_handles_.size());
+      for (size_t index = 0; index < registered_joint_cmd_handles_.size(); ++index)
+      {
+        auto ref_name = registered_joint_cmd_handles_[index]->get_name() + "_ref";
+        if (sptr->get_joint_command_handle(ref_name.c_str(), &registered_joint_ref_handles_[index]) 
+            != hardware_interface::HW_RET_OK ||
+            sptr->get_joint_command_handle((ref_name + "_vel").c_str(), &registered_joint_ref_vel_handles_[index]) 
+            != hardware_interface::HW_RET_OK)
+        {
+          RCLCPP_ERROR(this->get_lifecycle_node()->get_logger(), 
+            "Reference input from handles needs joint reference handles %s and %s_vel. Exiting.", 
+            ref_name.c_str(), ref_name.c_str());
+          return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+        }
+      }
+    }
+
+    // Feedforward mode also commands the joint velocities
+    if (feedforward_)
+    {
+      registered_joint_vel_cmd_handles_.resize(registered_joint_cmd_handles_.size());
+      for (size_t index = 0; index < registered_joint_cmd_handles_.size(); ++index)
+      {
+        auto vel_name = registered_joint_cmd_handles_[index]->get_name() + "_vel";
+        if (sptr->get_joint_command_handle(vel_name.c_str(), &registered_joint_vel_cmd_handles_[index]) 
+            != hardware_interface::HW_RET_OK)
+        {
+          RCLCPP_ERROR(this->get_lifecycle_node()->get_logger(), 
+            "Feedforward mode needs joint velocity command handle %s. Exiting.", vel_name.c_str());
+          return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+        }
+      }
+    }
   } 
   else
   {
     return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
   }
 
+  tracking_statistics_.set_settling_tolerance(settling_tolerance_);
+
   previous_update_time_ = this->get_lifecycle_node()->get_clock()->now();
   return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
 }
@@ -285,11 +442,6 @@ JointPositionController::on_activate(const rclcpp_lifecycle::State &previous_sta
     return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
   }
 
-  subscription_ = this->get_lifecycle_node()->create_subscription<ros2_control_interfaces::msg::JointControl>(
-    namespace_+"/joint_commands", rclcpp::SensorDataQoS(), 
-    std::bind(&JointPositionController::desired_position_subscrition_callback, this, std::placeholders::_1)
-    );
-
   auto pidParams = control_utils::Pid::Gains();
   pidParams = get_controller_pid();
 
@@ -300,19 +452,65 @@ JointPositionController::on_activate(const rclcpp_lifecycle::State &previous_sta
   }
 
   RCLCPP_INFO(this->get_lifecycle_node()->get_logger(), "Creating pid controllers");
-  for (auto &j : registered_joint_cmd_handles_)
+  pid_bank_.set_gains(pidParams);
+  pid_bank_.resize(registered_joint_cmd_handles_.size());
+
+  // desired_pos = commanded pos until told otherwise, so switched to while the control loop runs the joints carry on
+  // from where the outgoing controller left them. With feedforward its velocity is extrapolated over the horizon,
+  // bridging the cycle it may have run since.
+  pending_reference_ = JointReference();
+  for (size_t index = 0; index < registered_joint_cmd_handles_.size(); ++index)
+  {
+    pending_reference_.positions[index] = registered_joint_cmd_handles_[index]->get_cmd();
+    if (feedforward_)
+    {
+      pending_reference_.velocities[index] = registered_joint_vel_cmd_handles_[index]->get_cmd();
+    }
+  }
+  pending_reference_.stamp_ns = this->get_lifecycle_node()->get_clock()->now().nanoseconds();
+  desired_pos_buffer_.initialize(pending_reference_);
+  handle_reference_ = pending_reference_;
+  handle_reference_moving_ = false;
+
+  tracking_statistics_.resize(registered_joint_cmd_handles_.size());
+  tracking_buffer_.initialize(tracking_statistics_.summary());
+  tracked_stamp_ns_ = 0;
+  tracking_msg_ = ros2_control_interfaces::msg::TrackingErrorStats();
+  tracking_publisher_ = this->get_lifecycle_node()->create_publisher<ros2_control_interfaces::msg::TrackingErrorStats>(
+    "~/tracking_error", rclcpp::SystemDefaultsQoS());
+  tracking_publisher_->on_activate();
+  tracking_timer_ = this->get_lifecycle_node()->create_wall_timer(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(1.0 / tracking_stats_rate_)),
+    std::bind(&JointPositionController::publish_tracking_stats, this));
+
+  // Chained, the reference only comes from the handles
+  if (!reference_from_handles_)
   {
-    pid_controllers_map_[j->get_name()] = std::make_shared<control_utils::Pid>(pidParams);
+    subscription_ = this->get_lifecycle_node()->create_subscription<ros2_control_interfaces::msg::JointControl>(
+      namespace_+"/joint_commands", rclcpp::SensorDataQoS(), 
+      std::bind(&JointPositionController::desired_position_subscrition_callback, this, std::placeholders::_1)
+      );
   }
 
-  // desired_pos = initial_pos until told otherwise
-  int index = 0;
-  for (auto &cmd_handle : registered_joint_cmd_handles_)
+  // String free joint commands, only accepted if the controller has at most MAX_JOINTS joints
+  last_indexed_stamp_ns_ = 0;
+  if (!reference_from_handles_ && 
+      registered_joint_cmd_handles_.size() <= ros2_control_interfaces::msg::IndexedJointControl::MAX_JOINTS)
   {
-    desired_pos_map_.insert({cmd_handle->get_name(), registered_joint_state_handles_[index]->get_position()});
-    ++index;
+    indexed_subscription_ = 
+      this->get_lifecycle_node()->create_subscription<ros2_control_interfaces::msg::IndexedJointControl>(
+        namespace_+"/joint_commands_indexed", rclcpp::SensorDataQoS(), 
+        std::bind(&JointPositionController::indexed_command_subscription_callback, this, std::placeholders::_1)
+        );
   }
 
+  // Live retuning, the gains are swapped into the control loop without locking
+  pid_parameters_subscription_ = 
+    this->get_lifecycle_node()->create_subscription<ros2_control_interfaces::msg::PidParameters>(
+      namespace_+"/pid_parameters", rclcpp::QoS(10), 
+      std::bind(&JointPositionController::pid_parameters_callback, this, std::placeholders::_1)
+      );
+
   return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
 }
 
@@ -327,8 +525,12 @@ JointPositionController::on_deactivate(const rclcpp_lifecycle::State &previous_s
 
   (void)previous_state;
   RCLCPP_INFO(this->get_lifecycle_node()->get_logger(), "JointPositionController on_deactivate called");
-  pid_controllers_map_.clear();
   subscription_ = nullptr;
+  indexed_subscription_ = nullptr;
+  pid_parameters_subscription_ = nullptr;
+  tracking_timer_ = nullptr;
+  tracking_publisher_ = nullptr;
+  pid_bank_.reset();
   return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
 } 
 
@@ -345,7 +547,11 @@ JointPositionController::on_cleanup(const rclcpp_lifecycle::State &previous_stat
 
   registered_joint_state_handles_.clear();
   registered_joint_cmd_handles_.clear();
-  desired_pos_map_.clear();
+  registered_joint_vel_cmd_handles_.clear();
+  registered_joint_ref_handles_.clear();
+  registered_joint_ref_vel_handles_.clear();
+  joint_index_map_.clear();
+  joint_names_.clear();
 
   RCLCPP_INFO(this->get_lifecycle_node()->get_logger(), "JointPositionController on_cleanup called");
   return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
@@ -387,6 +593,150 @@ JointPositionController::on_shutdown(const rclcpp_lifecycle::State &previous_sta
 
 
 
+// helper function
+template <std::size_t N>
+controller_interface::controller_interface_ret_t
+JointPositionController::update_joints(const JointReference &reference, const rclcpp::Time &timeNow,
+                                       const rclcpp::Duration &timeElapsed)
+{
+  // The control law of update() for N joints, or for all joints if N is 0
+  const size_t joint_num = (N > 0) ? N : registered_joint_cmd_handles_.size();
+
+  if (!feedforward_)
+  {
+    // handles are stored in controller joint order
+    for (size_t i = 0; i < joint_num; i++)
+    {
+      errors_[i] = reference.positions[i] - registered_joint_state_handles_[i]->get_position();
+    }
+    track_errors(timeNow.nanoseconds(), reference.stamp_ns, true);
+
+    //--------------PID-----------------------------------------------------------------------------------------------
+    pid_bank_.compute_commands(errors_, additions_, timeElapsed);
+    //----------------------------------------------------------------------------------------------------------------
+
+    for (size_t i = 0; i < joint_num; i++)
+    {
+      auto curr_pos = registered_joint_state_handles_[i]->get_position();
+      if(curr_pos != reference.positions[i])
+      {
+        // TODO : Replace with proper NaN handling
+        registered_joint_cmd_handles_[i]->set_cmd(curr_pos + additions_[i]);
+      }
+    }
+    return hardware_interface::HW_RET_OK;
+  }
+
+  // Extrapolate the reference to now, and hold it once it is older than the horizon. A chained reference is current.
+  double tau = reference_from_handles_ ? 0.0 : std::max(0.0, (timeNow.nanoseconds() - reference.stamp_ns) * 1e-9);
+  double hold = (tau < feedforward_horizon_) ? 1.0 : 0.0;
+  tau = std::min(tau, feedforward_horizon_);
+  bool moving = false;
+  for (size_t i = 0; i < joint_num; i++)
+  {
+    ref_positions_[i] = reference.positions[i] + reference.velocities[i] * tau 
+                        + 0.5 * reference.accelerations[i] * tau * tau;
+    ref_velocities_[i] = hold * (reference.velocities[i] + reference.accelerations[i] * tau);
+    ref_accelerations_[i] = hold * reference.accelerations[i];
+    errors_[i] = ref_positions_[i] - registered_joint_state_handles_[i]->get_position();
+    moving = moving || ref_velocities_[i] != 0.0;
+  }
+  track_errors(timeNow.nanoseconds(), reference.stamp_ns, !moving);
+
+  //--------------PID-------------------------------------------------------------------------------------------------
+  pid_bank_.compute_commands(errors_, additions_, timeElapsed);
+  //------------------------------------------------------------------------------------------------------------------
+
+  double dt = timeElapsed.seconds();
+  if (dt <= 0.0)
+  {
+    return hardware_interface::HW_RET_OK;
+  }
+
+  for (size_t i = 0; i < joint_num; i++)
+  {
+    auto curr_pos = registered_joint_state_handles_[i]->get_position();
+    double feedforward = ref_velocities_[i] * dt + 0.5 * ref_accelerations_[i] * dt * dt;
+    registered_joint_cmd_handles_[i]->set_cmd(curr_pos + feedforward + additions_[i]);
+    registered_joint_vel_cmd_handles_[i]->set_cmd(ref_velocities_[i] + ref_accelerations_[i] * dt 
+                                                  + additions_[i] / dt);
+  }
+
+  return hardware_interface::HW_RET_OK;
+}
+
+
+// helper function
+void
+JointPositionController::advance_pending_reference(int64_t stamp_ns)
+{
+  // Extrapolates the working copy of the reference to stamp_ns, the same way update() does
+  if (feedforward_)
+  {
+    double tau = std::max(0.0, (stamp_ns - pending_reference_.stamp_ns) * 1e-9);
+    double hold = (tau < feedforward_horizon_) ? 1.0 : 0.0;
+    tau = std::min(tau, feedforward_horizon_);
+    for (size_t i = 0; i < registered_joint_cmd_handles_.size(); i++)
+    {
+      pending_reference_.positions[i] += pending_reference_.velocities[i] * tau 
+                                         + 0.5 * pending_reference_.accelerations[i] * tau * tau;
+      pending_reference_.velocities[i] = hold * (pending_reference_.velocities[i] 
+                                                 + pending_reference_.accelerations[i] * tau);
+      pending_reference_.accelerations[i] *= hold;
+    }
+  }
+  pending_reference_.stamp_ns = stamp_ns;
+}
+
+
+const JointReference &
+JointPositionController::read_reference_handles(int64_t now_ns)
+{
+  bool moving = false;
+  for (size_t i = 0; i < registered_joint_ref_handles_.size(); i++)
+  {
+    handle_reference_.positions[i] = registered_joint_ref_handles_[i]->get_cmd();
+    handle_reference_.velocities[i] = registered_joint_ref_vel_handles_[i]->get_cmd();
+    moving = moving || handle_reference_.velocities[i] != 0.0;
+  }
+  // A motion starts a new tracking segment
+  if (moving && !handle_reference_moving_)
+  {
+    handle_reference_.stamp_ns = now_ns;
+  }
+  handle_reference_moving_ = moving;
+  return handle_reference_;
+}
+
+
+void
+JointPositionController::track_errors(int64_t now_ns, int64_t reference_stamp_ns, bool at_goal)
+{
+  if (reference_stamp_ns != tracked_stamp_ns_)
+  {
+    tracked_stamp_ns_ = reference_stamp_ns;
+    tracking_statistics_.start(now_ns);
+  }
+  tracking_statistics_.add_sample(now_ns, errors_, at_goal);
+  tracking_buffer_.write_from_rt(tracking_statistics_.summary());
+}
+
+
+void
+JointPositionController::publish_tracking_stats()
+{
+  // Only new samples are published
+  const auto &summary = tracking_buffer_.read_from_non_rt();
+  if (summary.samples == 0 || 
+      (summary.segment == tracking_msg_.segment && summary.samples == tracking_msg_.samples))
+  {
+    return;
+  }
+  to_tracking_error_stats(summary, joint_names_, tracking_msg_);
+  tracking_publisher_->publish(tracking_msg_);
+}
+
+
 //helper function
 control_utils::Pid::Gains   //Kp, Ki, Kd
 JointPositionController::get_controller_pid()
@@ -444,6 +794,7 @@ JointPositionController::get_controller_pid()
     gain.i_max_ = res->i_max;
     gain.i_min_ = res->i_min;
     gain.antiwindup_ = res->antiwindup;
+    gain.d_cutoff_ = res->d_cutoff;
     return gain;
   }
 
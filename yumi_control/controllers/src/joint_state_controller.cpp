@@ -15,11 +15,33 @@ JointStateController::JointStateController()
 {
 }
 
+controller_interface::controller_interface_ret_t
+JointStateController::init(std::weak_ptr<hardware_interface::RobotHardware> robot_hardware,
+                           const std::string & controller_name)
+{
+  auto ret = ControllerInterface::init(robot_hardware, controller_name);
+  if (ret != controller_interface::CONTROLLER_INTERFACE_RET_SUCCESS)
+  {
+    return ret;
+  }
+  lifecycle_node_->declare_parameter<double>("publish_rate", publish_rate_);
+  return controller_interface::CONTROLLER_INTERFACE_RET_SUCCESS;
+}
+
 rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn
 JointStateController::on_configure(const rclcpp_lifecycle::State & previous_state)
 {
   (void) previous_state;
   namespace_ = this->get_lifecycle_node()->get_parameter("namespace").as_string(); 
+  publish_rate_ = lifecycle_node_->get_parameter("publish_rate").as_double();
+  if (publish_rate_ < 0.0)
+  {
+    RCLCPP_ERROR(lifecycle_node_->get_logger(), "publish_rate must not be negative");
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+  publish_period_ns_ = publish_rate_ > 0.0 ? static_cast<int64_t>(1e9 / publish_rate_) : 0;
+  next_publish_ns_ = 0;
+  clock_ = lifecycle_node_->get_clock();
 
   if (auto sptr = robot_hardware_.lock()) 
   {
@@ -35,22 +57,25 @@ JointStateController::on_configure(const rclcpp_lifecycle::State & previous_stat
     return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
   }
 
+  joint_state_publisher_ = lifecycle_node_->create_publisher<sensor_msgs::msg::JointState>(
+    namespace_+"/joint_states", rclcpp::SystemDefaultsQoS());      
+  joint_state_publisher_->on_activate();
+  realtime_publisher_ = 
+    std::make_unique<control_utils::RealtimePublisher<sensor_msgs::msg::JointState>>(joint_state_publisher_);
+
   size_t num_joints = registered_joint_handles_.size();
-  // default initialize joint state message
-  joint_state_msg_.position.resize(num_joints);
-  joint_state_msg_.velocity.resize(num_joints);
-  joint_state_msg_.effort.resize(num_joints);
+  // default initialize joint state message, the publishing thread is idle until the first one is handed over
+  auto & joint_state_msg = realtime_publisher_->msg_;
+  joint_state_msg.position.resize(num_joints);
+  joint_state_msg.velocity.resize(num_joints);
+  joint_state_msg.effort.resize(num_joints);
   // set known joint names
-  joint_state_msg_.name.reserve(num_joints);
+  joint_state_msg.name.reserve(num_joints);
   for (auto joint_handle : registered_joint_handles_) 
   {
-    joint_state_msg_.name.push_back(joint_handle->get_name());
+    joint_state_msg.name.push_back(joint_handle->get_name());
   }
 
-  joint_state_publisher_ = lifecycle_node_->create_publisher<sensor_msgs::msg::JointState>(
-    namespace_+"/joint_states", rclcpp::SystemDefaultsQoS());      
-  joint_state_publisher_->on_activate();
-
   return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
 }
 
@@ -62,17 +87,38 @@ JointStateController::update()
     return hardware_interface::HW_RET_ERROR;
   }
 
-  joint_state_msg_.header.stamp = rclcpp::Clock().now();
+  // Decimated to publish_rate, a late cycle does not make up for the missed ones
+  auto now = clock_->now();
+  if (publish_period_ns_ > 0)
+  {
+    if (now.nanoseconds() < next_publish_ns_)
+    {
+      return hardware_interface::HW_RET_OK;
+    }
+    next_publish_ns_ += publish_period_ns_;
+    if (next_publish_ns_ <= now.nanoseconds())
+    {
+      next_publish_ns_ = now.nanoseconds() + publish_period_ns_;
+    }
+  }
+
+  // Skip the cycle rather than wait for the previous state to be published
+  if (!realtime_publisher_->try_lock())
+  {
+    return hardware_interface::HW_RET_OK;
+  }
+  auto & joint_state_msg = realtime_publisher_->msg_;
+  joint_state_msg.header.stamp = now;
   size_t i = 0;
   for (auto joint_state_handle : registered_joint_handles_) {
-    joint_state_msg_.position[i] = joint_state_handle->get_position();
-    joint_state_msg_.velocity[i] = joint_state_handle->get_velocity();
-    joint_state_msg_.effort[i] = joint_state_handle->get_effort();
+    joint_state_msg.position[i] = joint_state_handle->get_position();
+    joint_state_msg.velocity[i] = joint_state_handle->get_velocity();
+    joint_state_msg.effort[i] = joint_state_handle->get_effort();
     ++i;
   }
 
   // publish
-  joint_state_publisher_->publish(joint_state_msg_);
+  realtime_publisher_->unlock_and_publish();
   return hardware_interface::HW_RET_OK;
 }
 
@@ -12,20 +12,26 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <iterator>
+#include <limits>
 #include <string>
 #include <memory>
 #include <vector>
 
 #include <controllers/joint_trajectory_controller.hpp>
 #include "builtin_interfaces/msg/time.hpp"
+#include "hardware_interface/utils/time_utils.hpp"
 #include "lifecycle_msgs/msg/transition.hpp"
 #include "lifecycle_msgs/msg/state.hpp"
 #include "rclcpp/time.hpp"
 #include "rclcpp_lifecycle/state.hpp"
 #include "rcutils/logging_macros.h"
+#include "ros2_control_utils/joint_order_hash.hpp"
 #include "trajectory_msgs/msg/joint_trajectory.hpp"
 #include "trajectory_msgs/msg/joint_trajectory_point.hpp"
 
@@ -34,6 +40,21 @@
 
   Trajectories are specified as a set of waypoints to be reached at specific time instants, which the controller 
   attempts to execute as well as the mechanism allows. Waypoints consist of positions, velocities and accelerations.
+
+  The progress along the trajectory can be scaled online through ~/speed_scaling, between 0 (pause) and 
+  max_speed_scale, without replanning.
+
+  Trajectories are received on ~/joint_trajectory, or as goals of the ~/follow_joint_trajectory action, which reports
+  feedback while executing and a result once the trajectory is completed within its tolerances, or aborted. A goal that
+  is preempted, replaced, stopped, taken over by a controller of higher priority or ended by deactivating the controller
+  is aborted with error_code -10.
+
+  For teleoperation and visual servoing single setpoints can be streamed on ~/servo instead, in controller joint order.
+  Targets streamed on ~/target are reached as fast as the jerk limits allow, each new one taken over mid-motion.
+
+  With a start_sync_peer, e.g. the controller of the other arm, a trajectory without a stamp and with the header.frame_id
+  "both_arms" starts together with the peer's half of the same plan, and the start skew between both is reported on
+  ~/start_skew. Other trajectories start at their stamp, or at once without one.
 */
 
 namespace ros_controllers
@@ -71,6 +92,36 @@ JointTrajectoryController::init(std::weak_ptr<hardware_interface::RobotHardware>
   // With the lifecycle node initialized, we can declare parameters
   lifecycle_node_->declare_parameter<std::vector<std::string>>("joints", joint_names_);
   lifecycle_node_->declare_parameter<std::vector<std::string>>("write_op_modes", write_op_names_);
+  lifecycle_node_->declare_parameter<double>("max_speed_scale", max_speed_scale_);
+  lifecycle_node_->declare_parameter<double>("speed_scale_max_rate", speed_scale_max_rate_);
+  lifecycle_node_->declare_parameter<double>("speed_scale_max_acceleration", speed_scale_max_acceleration_);
+  lifecycle_node_->declare_parameter<double>("action_monitor_rate", action_monitor_rate_);
+  lifecycle_node_->declare_parameter<double>("default_path_tolerance", default_path_tolerance_);
+  lifecycle_node_->declare_parameter<double>("default_goal_tolerance", default_goal_tolerance_);
+  lifecycle_node_->declare_parameter<double>("default_goal_time_tolerance", default_goal_time_tolerance_);
+  lifecycle_node_->declare_parameter<double>("servo_delay", servo_delay_ns_ * 1e-9);
+  lifecycle_node_->declare_parameter<bool>("servo_use_velocities", servo_use_velocities_);
+  lifecycle_node_->declare_parameter<double>("target_max_velocity", target_max_velocity_);
+  lifecycle_node_->declare_parameter<double>("target_max_acceleration", target_max_acceleration_);
+  lifecycle_node_->declare_parameter<double>("target_max_jerk", target_max_jerk_);
+  lifecycle_node_->declare_parameter<double>("target_extrapolation", target_extrapolation_);
+  lifecycle_node_->declare_parameter<std::vector<double>>("position_limits_lower", {});
+  lifecycle_node_->declare_parameter<std::vector<double>>("position_limits_upper", {});
+  lifecycle_node_->declare_parameter<std::vector<double>>("velocity_limits", {});
+  lifecycle_node_->declare_parameter<int>("max_trajectory_points", static_cast<int>(max_trajectory_points_));
+  lifecycle_node_->declare_parameter<std::string>("command_interface", command_interface_);
+  lifecycle_node_->declare_parameter<double>("stop_acceleration", stop_acceleration_);
+  lifecycle_node_->declare_parameter<double>("stop_jerk", stop_jerk_);
+  lifecycle_node_->declare_parameter<double>("stopped_velocity_threshold", stopped_velocity_threshold_);
+  lifecycle_node_->declare_parameter<std::string>("wrench_topic", "");
+  lifecycle_node_->declare_parameter<std::string>("external_torque_topic", "");
+  lifecycle_node_->declare_parameter<double>("contact_force_threshold", 0.0);
+  lifecycle_node_->declare_parameter<double>("settling_tolerance", settling_tolerance_);
+  lifecycle_node_->declare_parameter<double>("tracking_stats_rate", tracking_stats_rate_);
+  lifecycle_node_->declare_parameter<std::vector<double>>("contact_torque_thresholds", {});
+  lifecycle_node_->declare_parameter<std::string>("start_sync_peer", "");
+  lifecycle_node_->declare_parameter<double>("start_delay", start_delay_ns_ * 1e-9);
+  lifecycle_node_->declare_parameter<double>("start_sync_window", start_sync_window_ns_ * 1e-9);
 
   return CONTROLLER_INTERFACE_RET_SUCCESS;
 }
@@ -85,47 +136,140 @@ JointTrajectoryController::update()
       halt();
       is_halted = true;
     }
+    last_update_ns_ = 0;
+    stop_profile_active_ = false;
+    trajectory_sampled_ = false;
+    set_claims(claim_handles_, COMMAND_RELEASE);
     return CONTROLLER_INTERFACE_RET_SUCCESS;
   }
+
+  // The trajectory clock runs in every active cycle, also while no trajectory is executed
+  auto now = rclcpp::Clock().now();
+  advance_trajectory_clock(now.nanoseconds());
+
+  // Latest published trajectory, never blocks on the subscription callback
+  const auto & trajectory = trajectory_buffer_.read_from_rt();
+  bool servoing = servo_active_ && !is_stopped && !contact_stop_;
+  bool retargeting = !servoing && target_active_ && !is_stopped && !contact_stop_;
+  bool following = !servoing && !retargeting && !is_stopped && !contact_stop_ && new_trajectory && trajectory && 
+    !trajectory->is_empty() && trajectory.get() != taken_trajectory_;
+
+  // A contact stops the motion in this cycle
+  if (contact_detected_.exchange(false) && (servoing || retargeting || following)) 
+  {
+    record_contact(following ? trajectory.get() : nullptr, now.nanoseconds());
+    contact_stop_ = true;
+    servo_active_ = false;
+    target_active_ = false;
+    servoing = false;
+    retargeting = false;
+    following = false;
+  }
+
+  // Another controller of higher priority, e.g. the cartesian_velocity_controller, took the joints over. Setpoints and
+  // targets are followed on from the commands it leaves, and a trajectory is given up, the joints decelerating from
+  // there, so they are not pulled back once it hands them back.
+  if (claims_taken(claim_handles_)) 
+  {
+    servo_running_ = false;
+    target_running_ = false;
+    stop_profile_active_ = false;
+    if (following) 
+    {
+      taken_trajectory_ = trajectory.get();
+      following = false;
+    }
+  }
   
-  // If execution is signaled to stop, or no new trajectory is recieved 
-  if(is_stopped || !new_trajectory)
+  // Streamed setpoints are followed until a trajectory is received
+  if (servoing) 
   {
+    stop_profile_active_ = false;
+    stop_state_ = MOVING;
+    sample_servo(now.nanoseconds());
+    for (size_t index = 0; index < registered_joint_cmd_handles_.size(); ++index) 
+    {
+      registered_joint_cmd_handles_[index]->set_cmd(sampled_state_.positions[index]);
+      registered_joint_vel_cmd_handles_[index]->set_cmd(sampled_state_.velocities[index]);
+    }
+    set_claims(claim_handles_, COMMAND_CLAIM);
+    set_op_mode(hardware_interface::OperationMode::ACTIVE);
+    trajectory_sampled_ = false;
     return CONTROLLER_INTERFACE_RET_SUCCESS;
   }
+  servo_running_ = false;
 
-  // When no traj msg has been received yet
-  if (!traj_point_active_ptr_ || (*traj_point_active_ptr_)->is_empty()) 
+  // The latest target is chased until a trajectory or setpoint is received
+  if (retargeting) 
   {
+    stop_profile_active_ = false;
+    stop_state_ = MOVING;
+    sample_target(now.nanoseconds());
+    const auto & state = target_generator_.state();
+    for (size_t index = 0; index < registered_joint_cmd_handles_.size(); ++index) 
+    {
+      registered_joint_cmd_handles_[index]->set_cmd(state.positions[index]);
+      registered_joint_vel_cmd_handles_[index]->set_cmd(state.velocities[index]);
+    }
+    set_claims(claim_handles_, COMMAND_CLAIM);
+    set_op_mode(hardware_interface::OperationMode::ACTIVE);
+    trajectory_sampled_ = false;
     return CONTROLLER_INTERFACE_RET_SUCCESS;
   }
+  target_running_ = false;
 
-  // sample : Find the next valid point from the represented trajectory msg.
-  // valid point is the first point in the the msg with expected arrival time in the future.
-  auto traj_point_ptr = (*traj_point_active_ptr_)->sample(rclcpp::Clock().now());
-  
-  // If no next valid point can be found
-  if (traj_point_ptr == (*traj_point_active_ptr_)->end()) 
+  // If execution is signaled to stop, stopped by a contact, or there is no trajectory to follow, e.g. after a cancel,
+  // the joints are decelerated to rest
+  if (!following) 
   {
+    stop_motion(now.nanoseconds());
+    trajectory_sampled_ = false;
     return CONTROLLER_INTERFACE_RET_SUCCESS;
   }
-  
-  // If next valid point is the same as the previously found point
-  if (prev_traj_point_ptr_ == traj_point_ptr) 
+
+  // sample : Evaluate the spline of the trajectory at the current time of the trajectory clock.
+  // Nothing to do if the trajectory has not started yet, past its end the last point is held.
+  int64_t time_ns = now.nanoseconds() - std::llround(clock_offset_ns_);
+  trajectory_sampled_ = trajectory->sample(rclcpp::Time(time_ns), sampled_state_);
+  if (!trajectory_sampled_) 
   {
     return CONTROLLER_INTERFACE_RET_SUCCESS;
   }
-  
 
+  // First cycle at or after a synchronized start, reported to the peer by the action monitor
+  int64_t sync_start_ns = sync_start_ns_;
+  if (sync_start_ns != 0 && time_ns >= sync_start_ns && sync_start_ns_.compare_exchange_strong(sync_start_ns, 0)) 
+  {
+    sync_started_ns_ = now.nanoseconds();
+  }
+
+  stop_profile_active_ = false;
+  stop_state_ = MOVING;
+
+  // Once ended and settled the last point is left to the hardware, like the end of a stop profile, so a controller
+  // moving the joints afterwards, e.g. the cartesian_velocity_controller, is not pulled back to it on release.
+  // The state is still published for the goal tolerances.
+  bool ended = time_ns >= trajectory->end_time().nanoseconds();
+  if (ended && settled_trajectory_ == trajectory.get()) 
+  {
+    set_claims(claim_handles_, COMMAND_RELEASE);
+    publish_state(*trajectory, time_ns, now.nanoseconds());
+    return CONTROLLER_INTERFACE_RET_SUCCESS;
+  }
+
+  // The trajectory clock runs speed_scale_ times as fast as the wall clock, and so do the joints
   size_t joint_num = registered_joint_cmd_handles_.size();
+  bool settled = ended;
   for (size_t index = 0; index < joint_num; ++index) 
   {
-    registered_joint_cmd_handles_[index]->set_cmd(traj_point_ptr->positions[index]);
-    registered_joint_vel_cmd_handles_[index]->set_cmd(traj_point_ptr->velocities[index]);
+    registered_joint_cmd_handles_[index]->set_cmd(sampled_state_.positions[index]);
+    registered_joint_vel_cmd_handles_[index]->set_cmd(speed_scale_ * sampled_state_.velocities[index]);
+    settled = settled && std::abs(registered_joint_state_handles_[index]->get_velocity()) <= stopped_velocity_threshold_;
   }
+  settled_trajectory_ = settled ? trajectory.get() : nullptr;
+  set_claims(claim_handles_, settled ? COMMAND_RELEASE : COMMAND_CLAIM);
+  publish_state(*trajectory, time_ns, now.nanoseconds());
 
-
-  prev_traj_point_ptr_ = traj_point_ptr;
   set_op_mode(hardware_interface::OperationMode::ACTIVE);
 
   return CONTROLLER_INTERFACE_RET_SUCCESS;
@@ -143,6 +287,90 @@ JointTrajectoryController::on_configure(const rclcpp_lifecycle::State & previous
   // as long as the correct joint names and write_op are given in the yaml file, we should so far be ok.
   joint_names_ = lifecycle_node_->get_parameter("joints").as_string_array();
   write_op_names_ = lifecycle_node_->get_parameter("write_op_modes").as_string_array();
+  max_speed_scale_ = std::max(lifecycle_node_->get_parameter("max_speed_scale").as_double(), 0.0);
+  speed_scale_max_rate_ = lifecycle_node_->get_parameter("speed_scale_max_rate").as_double();
+  speed_scale_max_acceleration_ = lifecycle_node_->get_parameter("speed_scale_max_acceleration").as_double();
+  if (speed_scale_max_rate_ <= 0.0 || speed_scale_max_acceleration_ <= 0.0) 
+  {
+    RCLCPP_ERROR(logger, "speed_scale_max_rate and speed_scale_max_acceleration must be positive");
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+  target_speed_scale_ = std::min(1.0, max_speed_scale_);
+  action_monitor_rate_ = lifecycle_node_->get_parameter("action_monitor_rate").as_double();
+  default_path_tolerance_ = lifecycle_node_->get_parameter("default_path_tolerance").as_double();
+  default_goal_tolerance_ = lifecycle_node_->get_parameter("default_goal_tolerance").as_double();
+  default_goal_time_tolerance_ = lifecycle_node_->get_parameter("default_goal_time_tolerance").as_double();
+  if (action_monitor_rate_ <= 0.0) 
+  {
+    RCLCPP_ERROR(logger, "action_monitor_rate must be positive");
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+  servo_delay_ns_ = static_cast<int64_t>(std::max(lifecycle_node_->get_parameter("servo_delay").as_double(), 0.0) * 1e9);
+  servo_use_velocities_ = lifecycle_node_->get_parameter("servo_use_velocities").as_bool();
+  target_max_velocity_ = lifecycle_node_->get_parameter("target_max_velocity").as_double();
+  target_max_acceleration_ = lifecycle_node_->get_parameter("target_max_acceleration").as_double();
+  target_max_jerk_ = lifecycle_node_->get_parameter("target_max_jerk").as_double();
+  target_extrapolation_ = std::max(lifecycle_node_->get_parameter("target_extrapolation").as_double(), 0.0);
+  if (target_max_velocity_ <= 0.0 || target_max_acceleration_ <= 0.0 || target_max_jerk_ <= 0.0) 
+  {
+    RCLCPP_ERROR(logger, "target_max_velocity, target_max_acceleration and target_max_jerk must be positive");
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+  limits_.min_positions = lifecycle_node_->get_parameter("position_limits_lower").as_double_array();
+  limits_.max_positions = lifecycle_node_->get_parameter("position_limits_upper").as_double_array();
+  limits_.max_velocities = lifecycle_node_->get_parameter("velocity_limits").as_double_array();
+  for (const auto * limits : {&limits_.min_positions, &limits_.max_positions, &limits_.max_velocities}) 
+  {
+    if (!limits->empty() && limits->size() != joint_names_.size()) 
+    {
+      RCLCPP_ERROR(logger, "joint limits must be empty or given for each of the %zu joints", joint_names_.size());
+      return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+    }
+  }
+  command_interface_ = lifecycle_node_->get_parameter("command_interface").as_string();
+  if (command_interface_ != "position" && command_interface_ != "reference") 
+  {
+    RCLCPP_ERROR(logger, "command_interface must be position or reference, not %s", command_interface_.c_str());
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+  max_trajectory_points_ = static_cast<size_t>(
+    std::max<int64_t>(lifecycle_node_->get_parameter("max_trajectory_points").as_int(), 1));
+  stop_acceleration_ = lifecycle_node_->get_parameter("stop_acceleration").as_double();
+  stop_jerk_ = lifecycle_node_->get_parameter("stop_jerk").as_double();
+  stopped_velocity_threshold_ = lifecycle_node_->get_parameter("stopped_velocity_threshold").as_double();
+  if (stop_acceleration_ <= 0.0 || stop_jerk_ <= 0.0) 
+  {
+    RCLCPP_ERROR(logger, "stop_acceleration and stop_jerk must be positive");
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+  settling_tolerance_ = lifecycle_node_->get_parameter("settling_tolerance").as_double();
+  tracking_stats_rate_ = lifecycle_node_->get_parameter("tracking_stats_rate").as_double();
+  if (tracking_stats_rate_ <= 0.0) 
+  {
+    RCLCPP_ERROR(logger, "tracking_stats_rate must be positive");
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+  contact_force_threshold_ = std::max(lifecycle_node_->get_parameter("contact_force_threshold").as_double(), 0.0);
+  contact_torque_thresholds_ = lifecycle_node_->get_parameter("contact_torque_thresholds").as_double_array();
+  if (!contact_torque_thresholds_.empty() && contact_torque_thresholds_.size() != joint_names_.size()) 
+  {
+    RCLCPP_ERROR(logger, "contact_torque_thresholds must be empty or given for each of the %zu joints", 
+      joint_names_.size());
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+  double start_delay = lifecycle_node_->get_parameter("start_delay").as_double();
+  double start_sync_window = lifecycle_node_->get_parameter("start_sync_window").as_double();
+  if (start_delay < 0.0 || start_sync_window < 0.0) 
+  {
+    RCLCPP_ERROR(logger, "start_delay and start_sync_window must not be negative");
+    return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
+  }
+  if (start_sync_window >= start_delay) 
+  {
+    RCLCPP_WARN(logger, "start_sync_window is not below start_delay, the peer's start may come too late");
+  }
+  start_delay_ns_ = static_cast<int64_t>(start_delay * 1e9);
+  start_sync_window_ns_ = static_cast<int64_t>(start_sync_window * 1e9);
 
   if (!reset()) 
   {
@@ -168,23 +396,29 @@ JointTrajectoryController::on_configure(const rclcpp_lifecycle::State & previous
       }
     }
 
+    // Chained, the commands are references for the joint_position_controller
+    std::string suffix = command_interface_ == "reference" ? "_ref" : "";
+    std::vector<std::string> cmd_names;
     registered_joint_cmd_handles_.resize(joint_names_.size());
     registered_joint_vel_cmd_handles_.resize(joint_names_.size());
     for (size_t index = 0; index < joint_names_.size(); ++index) 
     {
-      auto ret = robot_hardware->get_joint_command_handle(joint_names_[index].c_str(), &registered_joint_cmd_handles_[index]);
+      auto cmd_name = joint_names_[index] + suffix;
+      cmd_names.push_back(cmd_name);
+      auto ret = robot_hardware->get_joint_command_handle(cmd_name.c_str(), &registered_joint_cmd_handles_[index]);
       if (ret != hardware_interface::HW_RET_OK) 
       {
-        RCLCPP_WARN( logger, "unable to obtain joint command handle for %s", joint_names_[index].c_str());
+        RCLCPP_WARN( logger, "unable to obtain joint command handle for %s", cmd_name.c_str());
         return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::FAILURE;
       }
-      ret = robot_hardware->get_joint_command_handle((joint_names_[index] + "_vel").c_str(), &registered_joint_vel_cmd_handles_[index]);
+      ret = robot_hardware->get_joint_command_handle((cmd_name + "_vel").c_str(), &registered_joint_vel_cmd_handles_[index]);
       if (ret != hardware_interface::HW_RET_OK) 
       {
-        RCLCPP_WARN( logger, "unable to obtain joint velocity command handle for %s", (joint_names_[index] + "_vel").c_str());
+        RCLCPP_WARN( logger, "unable to obtain joint velocity command handle for %s", (cmd_name + "_vel").c_str());
         return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::FAILURE;
       }
     }
+    claim_handles_ = get_claim_handles(*robot_hardware, cmd_names);
     registered_operation_mode_handles_.resize(write_op_names_.size());
     for (size_t index = 0; index < write_op_names_.size(); ++index) 
     {
@@ -208,6 +442,38 @@ JointTrajectoryController::on_configure(const rclcpp_lifecycle::State & previous
     return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::ERROR;
   }
 
+  // Preallocate the sampled states, so the control loop does not allocate
+  sampled_state_.resize(registered_joint_cmd_handles_.size());
+  start_state_.resize(registered_joint_cmd_handles_.size());
+  rt_state_.resize(registered_joint_cmd_handles_.size());
+  tracking_statistics_.resize(registered_joint_cmd_handles_.size());
+  tracking_statistics_.set_settling_tolerance(settling_tolerance_);
+  rt_state_.tracking = tracking_statistics_.summary();
+  state_buffer_.initialize(rt_state_);
+  if (registered_joint_cmd_handles_.size() > control_utils::TrackingStatistics::MAX_JOINTS) 
+  {
+    RCLCPP_WARN(logger, "tracking error statistics only cover the first %zu joints", 
+      control_utils::TrackingStatistics::MAX_JOINTS);
+  }
+  stop_positions_.assign(registered_joint_cmd_handles_.size(), 0.0);
+  stop_velocities_.assign(registered_joint_cmd_handles_.size(), 0.0);
+  stop_profile_active_ = false;
+  target_generator_.resize(registered_joint_cmd_handles_.size());
+  target_generator_.set_limits(limits_, target_max_velocity_, target_max_acceleration_, target_max_jerk_);
+  target_start_.resize(registered_joint_cmd_handles_.size());
+  target_buffer_.initialize(TargetPoint());
+  target_running_ = false;
+  stop_state_ = MOVING;
+  rt_contact_.positions.assign(registered_joint_cmd_handles_.size(), 0.0);
+  rt_contact_.velocities.assign(registered_joint_cmd_handles_.size(), 0.0);
+  contact_buffer_.initialize(rt_contact_);
+  contact_detected_ = false;
+  contact_stop_ = false;
+  reported_contact_count_ = contact_count_;
+
+  // Knots of a trajectory are its points, plus the current state and a spliced prefix
+  trajectory_pool_.allocate(TRAJECTORY_POOL_SIZE, registered_joint_cmd_handles_.size(), max_trajectory_points_ + 8);
+
   // Store 'home' pose
   traj_msg_home_ptr_ = std::make_shared<trajectory_msgs::msg::JointTrajectory>();
   traj_msg_home_ptr_->header.stamp.sec = 0;
@@ -222,31 +488,34 @@ JointTrajectoryController::on_configure(const rclcpp_lifecycle::State & previous
     traj_msg_home_ptr_->points[0].positions[index] = registered_joint_state_handles_[index]->get_position();
   }
 
-  traj_external_point_ptr_ = std::make_shared<Trajectory>();
-  traj_home_point_ptr_ = std::make_shared<Trajectory>();
-
 
   // subscriber call back
   // non realtime
   // TODO(karsten): check if traj msg and point time are valid
-  auto callback = [this, &logger](const std::shared_ptr<trajectory_msgs::msg::JointTrajectory> msg)  
+  auto callback = [this](const std::shared_ptr<trajectory_msgs::msg::JointTrajectory> msg)  
     -> void
     {
-      if (registered_joint_cmd_handles_.size() != msg->joint_names.size()) 
+      if (!subscriber_is_active_) 
       {
-        RCLCPP_ERROR(logger,
-          "number of joints in joint trajectory msg (%d) "
-          "does not match number of joint command handles (%d)\n",
-          msg->joint_names.size(), registered_joint_cmd_handles_.size());
+        return;
+      }
+      if (is_stopped) 
+      {
+        RCLCPP_WARN(lifecycle_node_->get_logger(), "trajectory rejected, the arm is stopped");
+        return;
       }
 
-      // http://wiki.ros.org/joint_trajectory_controller/UnderstandingTrajectoryReplacement
-      // always replace old msg with new one for now
-      if (subscriber_is_active_) 
+      // Only validated trajectories, in controller joint order, reach the control loop
+      auto validated = std::make_shared<trajectory_msgs::msg::JointTrajectory>();
+      std::string error;
+      if (validate_trajectory(*msg, joint_names_, limits_, *validated, error) != TrajectoryValidation::VALID) 
       {
-        new_trajectory = true;
-        traj_external_point_ptr_->update(msg);
+        RCLCPP_ERROR(lifecycle_node_->get_logger(), "trajectory rejected, %s", error.c_str());
+        return;
       }
+
+      // always replace old msg with new one for now, an active action goal is aborted
+      execute_trajectory(validated);
     };
 
   // TODO(karsten1987): create subscriber with subscription deactivated
@@ -261,6 +530,117 @@ JointTrajectoryController::on_configure(const rclcpp_lifecycle::State & previous
     rclcpp::SystemDefaultsQoS(), 
     std::bind(&JointTrajectoryController::stop_command_callback, this, std::placeholders::_1));
 
+  speed_scaling_subscriber_ = lifecycle_node_->create_subscription<std_msgs::msg::Float64>("~/speed_scaling", 
+    rclcpp::SystemDefaultsQoS(), 
+    std::bind(&JointTrajectoryController::speed_scaling_callback, this, std::placeholders::_1));
+
+  // Servo and target senders must use the same joint order
+  joint_order_hash_ = control_utils::joint_order_hash(joint_names_);
+  servo_active_ = false;
+  target_active_ = false;
+  if (joint_names_.size() <= IndexedJointControl::MAX_JOINTS) 
+  {
+    RCLCPP_INFO(logger, "Joint order hash for servo setpoints and targets: %u", joint_order_hash_);
+    servo_subscriber_ = lifecycle_node_->create_subscription<IndexedJointControl>("~/servo", 
+      rclcpp::SensorDataQoS(), 
+      std::bind(&JointTrajectoryController::servo_command_callback, this, std::placeholders::_1));
+    target_subscriber_ = lifecycle_node_->create_subscription<IndexedJointControl>("~/target", 
+      rclcpp::SensorDataQoS(), 
+      std::bind(&JointTrajectoryController::target_command_callback, this, std::placeholders::_1));
+  }
+
+  // Contact guard, the measurements are only subscribed to if a topic is given
+  auto wrench_topic = lifecycle_node_->get_parameter("wrench_topic").as_string();
+  if (!wrench_topic.empty()) 
+  {
+    wrench_subscriber_ = lifecycle_node_->create_subscription<geometry_msgs::msg::WrenchStamped>(wrench_topic, 
+      rclcpp::SensorDataQoS(), 
+      std::bind(&JointTrajectoryController::wrench_callback, this, std::placeholders::_1));
+  }
+  else 
+  {
+    RCLCPP_INFO(logger, "No wrench_topic, the contact force guard is unavailable");
+  }
+  auto external_torque_topic = lifecycle_node_->get_parameter("external_torque_topic").as_string();
+  if (!external_torque_topic.empty()) 
+  {
+    external_torque_subscriber_ = lifecycle_node_->create_subscription<sensor_msgs::msg::JointState>(
+      external_torque_topic, rclcpp::SensorDataQoS(), 
+      std::bind(&JointTrajectoryController::external_torque_callback, this, std::placeholders::_1));
+  }
+  else 
+  {
+    RCLCPP_INFO(logger, "No external_torque_topic, the contact torque guard is unavailable");
+  }
+  contact_force_threshold_subscriber_ = lifecycle_node_->create_subscription<std_msgs::msg::Float64>(
+    "~/contact_force_threshold", rclcpp::SystemDefaultsQoS(), 
+    [this](std_msgs::msg::Float64::UniquePtr msg)
+    {
+      contact_force_threshold_ = std::isfinite(msg->data) ? std::max(msg->data, 0.0) : 0.0;
+    });
+  contact_publisher_ = lifecycle_node_->create_publisher<sensor_msgs::msg::JointState>("~/contact", 
+    rclcpp::SystemDefaultsQoS());
+  contact_publisher_->on_activate();
+
+  action_server_ = rclcpp_action::create_server<FollowJointTrajectory>(
+    lifecycle_node_->get_node_base_interface(),
+    lifecycle_node_->get_node_clock_interface(),
+    lifecycle_node_->get_node_logging_interface(),
+    lifecycle_node_->get_node_waitables_interface(),
+    std::string(lifecycle_node_->get_name()) + "/follow_joint_trajectory",
+    std::bind(&JointTrajectoryController::handle_goal, this, std::placeholders::_1, std::placeholders::_2),
+    std::bind(&JointTrajectoryController::handle_cancel, this, std::placeholders::_1),
+    std::bind(&JointTrajectoryController::handle_accepted, this, std::placeholders::_1));
+
+  // Reports if the arm is at rest after a stop, latched for late subscribers
+  stopped_publisher_ = lifecycle_node_->create_publisher<std_msgs::msg::Bool>("~/stopped", 
+    rclcpp::QoS(1).transient_local());
+  stopped_publisher_->on_activate();
+  published_stop_state_ = -1;
+
+  tracking_publisher_ = lifecycle_node_->create_publisher<ros2_control_interfaces::msg::TrackingErrorStats>(
+    "~/tracking_error", rclcpp::SystemDefaultsQoS());
+  tracking_publisher_->on_activate();
+  tracking_msg_ = ros2_control_interfaces::msg::TrackingErrorStats();
+  tracking_timer_ = lifecycle_node_->create_wall_timer(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(1.0 / tracking_stats_rate_)),
+    [this]()
+    {
+      publish_tracking_stats(state_buffer_.read_from_non_rt().tracking);
+    });
+
+  // Synchronized start, only with a peer
+  auto start_sync_peer = lifecycle_node_->get_parameter("start_sync_peer").as_string();
+  pending_start_ = PendingStart();
+  peer_start_ = StartReport();
+  peer_started_ = StartReport();
+  own_started_ = StartReport();
+  sync_start_ns_ = 0;
+  sync_started_ns_ = 0;
+  if (!start_sync_peer.empty()) 
+  {
+    RCLCPP_INFO(logger, "Trajectories start in sync with %s", start_sync_peer.c_str());
+    start_publisher_ = lifecycle_node_->create_publisher<TrajectoryStart>("~/trajectory_start", 
+      rclcpp::SystemDefaultsQoS());
+    start_publisher_->on_activate();
+    start_skew_publisher_ = lifecycle_node_->create_publisher<std_msgs::msg::Float64>("~/start_skew", 
+      rclcpp::SystemDefaultsQoS());
+    start_skew_publisher_->on_activate();
+    start_sync_subscriber_ = lifecycle_node_->create_subscription<TrajectoryStart>(
+      start_sync_peer + "/trajectory_start", rclcpp::SystemDefaultsQoS(), 
+      std::bind(&JointTrajectoryController::start_sync_callback, this, std::placeholders::_1));
+  }
+
+  action_monitor_timer_ = lifecycle_node_->create_wall_timer(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(1.0 / action_monitor_rate_)),
+    [this]()
+    {
+      publish_stop_state();
+      publish_contact();
+      publish_started();
+      monitor_active_goal();
+    });
+
   // TODO(karsten1987): no lifecyle for subscriber yet
   // joint_command_subscriber_->on_activate();
 
@@ -276,7 +656,15 @@ JointTrajectoryController::on_activate(const rclcpp_lifecycle::State & previous_
 
   is_halted = false;
   subscriber_is_active_ = true;
-  traj_point_active_ptr_ = &traj_external_point_ptr_;
+
+  // Bumpless start, also when switched to while the control loop runs. A trajectory left over from before, e.g. the
+  // home trajectory of on_cleanup, is not resumed, the first cycle decelerates from the joint commands as they are.
+  publish_trajectory(nullptr);
+  new_trajectory = false;
+  servo_active_ = false;
+  target_active_ = false;
+  stop_profile_active_ = false;
+  last_update_ns_ = 0;
 
   // TODO(karsten1987): activate subscriptions of subscriber
   return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
@@ -287,6 +675,10 @@ JointTrajectoryController::on_deactivate(const rclcpp_lifecycle::State & previou
 {
   (void) previous_state;
   subscriber_is_active_ = false;
+  if (active_goal_) 
+  {
+    finish_active_goal(false, GOAL_PREEMPTED, "controller deactivated");
+  }
 
   return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
 }
@@ -296,9 +688,10 @@ JointTrajectoryController::on_cleanup(const rclcpp_lifecycle::State & previous_s
 {
   (void) previous_state;
 
-  // go home
-  traj_home_point_ptr_->update(traj_msg_home_ptr_);
-  traj_point_active_ptr_ = &traj_home_point_ptr_;
+  // go home, now on the trajectory clock
+  auto home = std::make_shared<trajectory_msgs::msg::JointTrajectory>(*traj_msg_home_ptr_);
+  home->header.stamp = to_trajectory_time(rclcpp::Clock().now());
+  publish_trajectory(std::make_shared<Trajectory>(home));
 
   return rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
 }
@@ -322,17 +715,36 @@ JointTrajectoryController::reset()
   // write_op_names_.clear();
 
   registered_joint_cmd_handles_.clear();
+  claim_handles_.clear();
   registered_joint_state_handles_.clear();
   registered_operation_mode_handles_.clear();
 
   subscriber_is_active_ = false;
   joint_command_subscriber_.reset();
+  servo_subscriber_.reset();
+  servo_active_ = false;
+  target_subscriber_.reset();
+  target_active_ = false;
+  if (active_goal_) 
+  {
+    finish_active_goal(false, GOAL_PREEMPTED, "controller reset");
+  }
+  action_monitor_timer_.reset();
+  action_server_.reset();
+  stopped_publisher_.reset();
+  tracking_timer_.reset();
+  tracking_publisher_.reset();
+  wrench_subscriber_.reset();
+  external_torque_subscriber_.reset();
+  contact_force_threshold_subscriber_.reset();
+  contact_publisher_.reset();
+  start_sync_subscriber_.reset();
+  start_publisher_.reset();
+  start_skew_publisher_.reset();
+  pending_start_ = PendingStart();
+  settled_trajectory_ = nullptr;
 
-  // iterator has no default value
-  // prev_traj_point_ptr_;
-  traj_point_active_ptr_ = nullptr;
-  traj_external_point_ptr_.reset();
-  traj_home_point_ptr_.reset();
+  publish_trajectory(nullptr);
   traj_msg_home_ptr_.reset();
 
   is_halted = false;
@@ -374,17 +786,907 @@ JointTrajectoryController::stop_command_callback(std_msgs::msg::Bool::UniquePtr
   if(msg->data == true) 
   {
     is_stopped = true;
-    traj_point_active_ptr_ = nullptr; // If execution is stopped, trash the rest of the trajectory.
+    servo_active_ = false;
+    target_active_ = false;
+    publish_trajectory(nullptr); // If execution is stopped, trash the rest of the trajectory.
     new_trajectory = false;
+    contact_stop_ = false;
+    published_stop_state_ = -1;  // Report again, also if the arm already is at rest
   }
   // If signaled to start again.
   else if(msg->data == false)
   {
-    traj_point_active_ptr_ = &traj_external_point_ptr_;
     is_stopped = false;
   }
 }
 
+void
+JointTrajectoryController::speed_scaling_callback(std_msgs::msg::Float64::UniquePtr msg)
+{
+  if (!std::isfinite(msg->data)) 
+  {
+    RCLCPP_WARN(lifecycle_node_->get_logger(), "ignoring non-finite speed scaling");
+    return;
+  }
+  double scale = std::min(std::max(msg->data, 0.0), max_speed_scale_);
+  if (scale != msg->data) 
+  {
+    RCLCPP_WARN(lifecycle_node_->get_logger(), "speed scaling %f clamped to %f", msg->data, scale);
+  }
+  target_speed_scale_ = scale;
+}
+
+void
+JointTrajectoryController::servo_command_callback(IndexedJointControl::UniquePtr msg)
+{
+  if (!subscriber_is_active_ || is_stopped || contact_stop_) 
+  {
+    return;
+  }
+  if (msg->joint_order_hash != joint_order_hash_ || msg->num_joints != registered_joint_cmd_handles_.size()) 
+  {
+    RCLCPP_WARN(lifecycle_node_->get_logger(),
+      "Servo setpoint with joint order hash %u and %u joints does not match this controller (%u, %zu). "
+      "Setpoint ignored.", msg->joint_order_hash, msg->num_joints, joint_order_hash_,
+      registered_joint_cmd_handles_.size());
+    return;
+  }
+
+  for (size_t index = 0; index < msg->num_joints; ++index) 
+  {
+    if (!std::isfinite(msg->goals[index]) || !std::isfinite(msg->velocities[index])) 
+    {
+      RCLCPP_WARN(lifecycle_node_->get_logger(), "Non-finite servo setpoint ignored");
+      return;
+    }
+  }
+
+  // The delay keeps the next setpoint queued when the current one is reached, despite jitter in the stream.
+  // Positions are clamped to the joint limits, as trajectories are validated against them.
+  ServoPoint point;
+  int64_t stamp_ns = rclcpp::Time(msg->stamp).nanoseconds();
+  point.time_ns = (stamp_ns == 0 ? rclcpp::Clock().now().nanoseconds() : stamp_ns) + servo_delay_ns_;
+  for (size_t index = 0; index < msg->num_joints; ++index) 
+  {
+    double position = msg->goals[index];
+    if (!limits_.min_positions.empty()) 
+    {
+      position = std::max(position, limits_.min_positions[index]);
+    }
+    if (!limits_.max_positions.empty()) 
+    {
+      position = std::min(position, limits_.max_positions[index]);
+    }
+    point.positions[index] = position;
+    point.velocities[index] = msg->velocities[index];
+  }
+
+  if (!servo_active_) 
+  {
+    // Leave trajectory execution and target following, an active goal is aborted by the monitor
+    publish_trajectory(nullptr);
+    new_trajectory = false;
+    target_active_ = false;
+    servo_active_ = true;
+  }
+  if (!servo_queue_.push(point)) 
+  {
+    RCLCPP_WARN(lifecycle_node_->get_logger(), "Servo queue full, setpoint dropped");
+  }
+}
+
+void
+JointTrajectoryController::sample_servo(int64_t now_ns)
+{
+  size_t joint_num = registered_joint_cmd_handles_.size();
+  if (!servo_running_) 
+  {
+    // Start from the commanded position
+    servo_next_.time_ns = now_ns;
+    for (size_t index = 0; index < joint_num; ++index) 
+    {
+      servo_next_.positions[index] = registered_joint_cmd_handles_[index]->get_cmd();
+      servo_next_.velocities[index] = 0.0;
+    }
+    servo_holding_ = true;
+    servo_running_ = true;
+  }
+
+  // Move on to the next segment once the end of the current one is reached
+  ServoPoint point;
+  while (now_ns >= servo_next_.time_ns) 
+  {
+    if (!servo_queue_.pop(point)) 
+    {
+      // Stream stopped, hold the last setpoint
+      servo_holding_ = true;
+      break;
+    }
+    if (point.time_ns <= servo_next_.time_ns) 
+    {
+      continue;  // Out of order or stale
+    }
+
+    servo_prev_ = servo_next_;
+    if (servo_holding_) 
+    {
+      // Resume from the held setpoint now, a late setpoint is reached after the servo delay
+      servo_prev_.time_ns = now_ns;
+      servo_prev_.velocities.fill(0.0);
+      point.time_ns = std::max(point.time_ns, now_ns + std::max<int64_t>(servo_delay_ns_, 1000000));
+      servo_holding_ = false;
+    }
+    servo_next_ = point;
+
+    // Without streamed velocities the tangent is the central difference over the neighbouring setpoints
+    if (!servo_use_velocities_) 
+    {
+      const ServoPoint * after = servo_queue_.front();
+      const ServoPoint & before = servo_prev_;
+      const ServoPoint & last = (after && after->time_ns > servo_next_.time_ns) ? *after : servo_next_;
+      double span = (last.time_ns - before.time_ns) * 1e-9;
+      for (size_t index = 0; index < joint_num; ++index) 
+      {
+        servo_next_.velocities[index] = (last.positions[index] - before.positions[index]) / span;
+      }
+    }
+
+    // A far setpoint is reached no faster than the velocity limits allow. With the tangents capped at the limit,
+    // a mean velocity of at most a third of the limit keeps the whole cubic Hermite segment within it.
+    if (!limits_.max_velocities.empty()) 
+    {
+      int64_t min_duration_ns = 0;
+      for (size_t index = 0; index < joint_num; ++index) 
+      {
+        double max_velocity = limits_.max_velocities[index];
+        double distance = std::abs(servo_next_.positions[index] - servo_prev_.positions[index]);
+        min_duration_ns = std::max<int64_t>(min_duration_ns, std::llround(3e9 * distance / max_velocity));
+        servo_next_.velocities[index] = std::min(std::max(servo_next_.velocities[index], -max_velocity), 
+          max_velocity);
+      }
+      servo_next_.time_ns = std::max(servo_next_.time_ns, servo_prev_.time_ns + min_duration_ns);
+    }
+  }
+
+  if (servo_holding_) 
+  {
+    for (size_t index = 0; index < joint_num; ++index) 
+    {
+      sampled_state_.positions[index] = servo_next_.positions[index];
+      sampled_state_.velocities[index] = 0.0;
+    }
+    return;
+  }
+
+  // Cubic Hermite segment between the previous and next setpoint
+  double T = (servo_next_.time_ns - servo_prev_.time_ns) * 1e-9;
+  double u = std::min(std::max((now_ns - servo_prev_.time_ns) * 1e-9 / T, 0.0), 1.0);
+  double u2 = u * u;
+  double u3 = u2 * u;
+  for (size_t index = 0; index < joint_num; ++index) 
+  {
+    double p0 = servo_prev_.positions[index], p1 = servo_next_.positions[index];
+    double m0 = servo_prev_.velocities[index] * T, m1 = servo_next_.velocities[index] * T;
+    sampled_state_.positions[index] = (2 * u3 - 3 * u2 + 1) * p0 + (u3 - 2 * u2 + u) * m0 + 
+      (-2 * u3 + 3 * u2) * p1 + (u3 - u2) * m1;
+    sampled_state_.velocities[index] = ((6 * u2 - 6 * u) * p0 + (3 * u2 - 4 * u + 1) * m0 + 
+      (-6 * u2 + 6 * u) * p1 + (3 * u2 - 2 * u) * m1) / T;
+  }
+}
+
+void
+JointTrajectoryController::target_command_callback(IndexedJointControl::UniquePtr msg)
+{
+  if (!subscriber_is_active_ || is_stopped || contact_stop_) 
+  {
+    return;
+  }
+  if (msg->joint_order_hash != joint_order_hash_ || msg->num_joints != registered_joint_cmd_handles_.size()) 
+  {
+    RCLCPP_WARN(lifecycle_node_->get_logger(),
+      "Target with joint order hash %u and %u joints does not match this controller (%u, %zu). "
+      "Target ignored.", msg->joint_order_hash, msg->num_joints, joint_order_hash_,
+      registered_joint_cmd_handles_.size());
+    return;
+  }
+  for (size_t index = 0; index < msg->num_joints; ++index) 
+  {
+    if (!std::isfinite(msg->goals[index]) || !std::isfinite(msg->velocities[index])) 
+    {
+      RCLCPP_WARN(lifecycle_node_->get_logger(), "Non-finite target ignored");
+      return;
+    }
+  }
+
+  TargetPoint target;
+  int64_t stamp_ns = rclcpp::Time(msg->stamp).nanoseconds();
+  target.stamp_ns = stamp_ns == 0 ? rclcpp::Clock().now().nanoseconds() : stamp_ns;
+  for (size_t index = 0; index < msg->num_joints; ++index) 
+  {
+    target.positions[index] = msg->goals[index];
+    target.velocities[index] = msg->velocities[index];
+  }
+
+  // Written before the target is followed, so update() never sees an older one
+  target_buffer_.write_from_non_rt(target);
+  if (!target_active_) 
+  {
+    // Leave trajectory execution and servoing, an active goal is aborted by the monitor
+    publish_trajectory(nullptr);
+    new_trajectory = false;
+    servo_active_ = false;
+    target_active_ = true;
+  }
+}
+
+void
+JointTrajectoryController::sample_target(int64_t now_ns)
+{
+  size_t joint_num = registered_joint_cmd_handles_.size();
+  if (!target_running_) 
+  {
+    // Take over from the commanded state, with the acceleration of the trajectory if one was followed until now
+    double scale2 = speed_scale_ * speed_scale_;
+    for (size_t index = 0; index < joint_num; ++index) 
+    {
+      target_start_.positions[index] = registered_joint_cmd_handles_[index]->get_cmd();
+      target_start_.velocities[index] = registered_joint_vel_cmd_handles_[index]->get_cmd();
+      target_start_.accelerations[index] = trajectory_sampled_ ? scale2 * sampled_state_.accelerations[index] : 0.0;
+    }
+    target_generator_.reset(target_start_.positions, target_start_.velocities, target_start_.accelerations);
+    target_last_ns_ = now_ns;
+    target_running_ = true;
+  }
+  double dt = (now_ns - target_last_ns_) * 1e-9;
+  target_last_ns_ = now_ns;
+
+  // The target moves on at its velocity for target_extrapolation_ after its stamp, and then stays put
+  const auto & target = target_buffer_.read_from_rt();
+  double age = std::max((now_ns - target.stamp_ns) * 1e-9, 0.0);
+  bool moving = age <= target_extrapolation_;
+  age = std::min(age, target_extrapolation_);
+  for (size_t index = 0; index < joint_num; ++index) 
+  {
+    target_generator_.set_target(index, target.positions[index] + target.velocities[index] * age, 
+      moving ? target.velocities[index] : 0.0);
+  }
+  target_generator_.update(dt);
+}
+
+void
+JointTrajectoryController::stop_motion(int64_t now_ns)
+{
+  size_t joint_num = registered_joint_cmd_handles_.size();
+  if (!stop_profile_active_) 
+  {
+    // Decelerate from the commanded state with the velocity ramp v(t) = v0 (1 - 3 tau^2 + 2 tau^3), tau = t / T.
+    // Its peak acceleration is 1.5 |v0| / T and its peak jerk 6 |v0| / T^2. T is the shortest duration within both
+    // limits for every joint, so the joints stop together and stay close to the path.
+    stop_duration_ = 0.0;
+    for (size_t index = 0; index < joint_num; ++index) 
+    {
+      stop_positions_[index] = registered_joint_cmd_handles_[index]->get_cmd();
+      stop_velocities_[index] = registered_joint_vel_cmd_handles_[index]->get_cmd();
+      double speed = std::abs(stop_velocities_[index]);
+      stop_duration_ = std::max({stop_duration_, 1.5 * speed / stop_acceleration_, std::sqrt(6.0 * speed / stop_jerk_)});
+    }
+    stop_start_ns_ = now_ns;
+    stop_profile_active_ = true;
+    stop_profile_written_ = false;
+    stop_state_ = STOPPING;
+  }
+
+  double elapsed = (now_ns - stop_start_ns_) * 1e-9;
+  double tau = stop_duration_ > 0.0 ? std::min(elapsed / stop_duration_, 1.0) : 1.0;
+  double tau2 = tau * tau;
+  // Once at rest the commands are left alone and released, so another controller, e.g. the
+  // cartesian_velocity_controller, can move the joints and the hardware holds where it left them
+  for (size_t index = 0; index < joint_num && !stop_profile_written_; ++index) 
+  {
+    double v0 = stop_velocities_[index];
+    registered_joint_cmd_handles_[index]->set_cmd(
+      stop_positions_[index] + v0 * stop_duration_ * (tau - tau2 * tau + 0.5 * tau2 * tau2));
+    registered_joint_vel_cmd_handles_[index]->set_cmd(v0 * (1.0 - 3.0 * tau2 + 2.0 * tau2 * tau));
+  }
+  set_claims(claim_handles_, stop_profile_written_ ? COMMAND_RELEASE : COMMAND_CLAIM);
+  stop_profile_written_ = tau >= 1.0;
+
+  // At rest once the profile is done and the joints have settled
+  if (tau >= 1.0 && stop_state_ == STOPPING) 
+  {
+    bool settled = true;
+    for (size_t index = 0; index < joint_num; ++index) 
+    {
+      settled = settled && std::abs(registered_joint_state_handles_[index]->get_velocity()) <= stopped_velocity_threshold_;
+    }
+    if (settled) 
+    {
+      stop_state_ = STOPPED;
+    }
+  }
+}
+
+void
+JointTrajectoryController::publish_stop_state()
+{
+  int stop_state = stop_state_ == STOPPED;
+  if (stop_state == published_stop_state_ || !stopped_publisher_) 
+  {
+    return;
+  }
+  std_msgs::msg::Bool msg;
+  msg.data = stop_state;
+  stopped_publisher_->publish(msg);
+  published_stop_state_ = stop_state;
+}
+
+void
+JointTrajectoryController::wrench_callback(geometry_msgs::msg::WrenchStamped::UniquePtr msg)
+{
+  const auto & force = msg->wrench.force;
+  double threshold = contact_force_threshold_;
+  bool above = threshold > 0.0 && 
+    std::sqrt(force.x * force.x + force.y * force.y + force.z * force.z) > threshold;
+
+  // Only crossing the threshold is a contact, so a motion started in contact, e.g. moving away, is not stopped
+  if (above && !force_above_threshold_) 
+  {
+    contact_detected_ = true;
+  }
+  force_above_threshold_ = above;
+}
+
+void
+JointTrajectoryController::external_torque_callback(sensor_msgs::msg::JointState::UniquePtr msg)
+{
+  // Torques in controller joint order, as sent by the robot controller
+  bool above = false;
+  for (size_t index = 0; index < contact_torque_thresholds_.size() && index < msg->effort.size(); ++index) 
+  {
+    above = above || (contact_torque_thresholds_[index] > 0.0 && 
+      std::abs(msg->effort[index]) > contact_torque_thresholds_[index]);
+  }
+  if (above && !torque_above_threshold_) 
+  {
+    contact_detected_ = true;
+  }
+  torque_above_threshold_ = above;
+}
+
+void
+JointTrajectoryController::record_contact(const Trajectory * trajectory, int64_t now_ns)
+{
+  // Realtime, rt_contact_ was sized in on_configure
+  rt_contact_.trajectory = trajectory;
+  rt_contact_.stamp_ns = now_ns;
+  for (size_t index = 0; index < registered_joint_state_handles_.size(); ++index) 
+  {
+    rt_contact_.positions[index] = registered_joint_state_handles_[index]->get_position();
+    rt_contact_.velocities[index] = registered_joint_state_handles_[index]->get_velocity();
+  }
+  contact_buffer_.write_from_rt(rt_contact_);
+  contact_count_++;
+}
+
+void
+JointTrajectoryController::publish_contact()
+{
+  uint32_t contact_count = contact_count_;
+  if (contact_count == reported_contact_count_) 
+  {
+    return;
+  }
+  reported_contact_count_ = contact_count;
+  const auto & contact = contact_buffer_.read_from_non_rt();
+
+  sensor_msgs::msg::JointState msg;
+  msg.header.stamp = rclcpp::Time(contact.stamp_ns);
+  msg.name = joint_names_;
+  msg.position = contact.positions;
+  msg.velocity = contact.velocities;
+  contact_publisher_->publish(msg);
+  RCLCPP_INFO(lifecycle_node_->get_logger(), "contact, motion stopped");
+
+  if (active_goal_ && contact.trajectory == active_goal_->trajectory.get()) 
+  {
+    finish_active_goal(false, FollowJointTrajectory::Result::PATH_TOLERANCE_VIOLATED, "stopped on contact");
+  }
+}
+
+void
+JointTrajectoryController::advance_trajectory_clock(int64_t now_ns)
+{
+  double dt = last_update_ns_ > 0 ? (now_ns - last_update_ns_) * 1e-9 : 0.0;
+  last_update_ns_ = now_ns;
+  if (dt <= 0.0) 
+  {
+    return;
+  }
+
+  // Ramp the scale towards the target. The rate is limited to what can still be braked to zero at the target, and
+  // changes by at most the acceleration limit, so the scale is C1 and the joint jerk stays bounded.
+  double target = target_speed_scale_;
+  double error = target - speed_scale_;
+  double max_change = speed_scale_max_acceleration_ * dt;
+  if (std::abs(error) <= std::abs(speed_scale_rate_) * dt && std::abs(speed_scale_rate_) <= max_change) 
+  {
+    // Reached the target in this cycle
+    speed_scale_ = target;
+    speed_scale_rate_ = 0.0;
+  }
+  else 
+  {
+    double remaining = std::max(std::abs(error) - 0.5 * std::abs(speed_scale_rate_) * dt, 0.0);
+    double rate = std::copysign(
+      std::min(speed_scale_max_rate_, std::sqrt(2.0 * speed_scale_max_acceleration_ * remaining)), error);
+    speed_scale_rate_ += std::min(std::max(rate - speed_scale_rate_, -max_change), max_change);
+    speed_scale_ = std::max(speed_scale_ + speed_scale_rate_ * dt, 0.0);
+  }
+
+  // The trajectory clock falls behind the wall clock by the time not spent at full speed
+  clock_offset_ns_ += (1.0 - speed_scale_) * dt * 1e9;
+  trajectory_clock_offset_ns_ = std::llround(clock_offset_ns_);
+}
+
+rclcpp::Time
+JointTrajectoryController::to_trajectory_time(const rclcpp::Time & wall_time) const
+{
+  return rclcpp::Time(wall_time.nanoseconds() - trajectory_clock_offset_ns_.load());
+}
+
+void
+JointTrajectoryController::publish_trajectory(std::shared_ptr<Trajectory> trajectory)
+{
+  // Non realtime, the trajectory replaced in the buffer may be freed here
+  published_trajectory_ = trajectory;
+  trajectory_buffer_.write_from_non_rt(trajectory);
+}
+
+std::shared_ptr<Trajectory>
+JointTrajectoryController::execute_trajectory(std::shared_ptr<trajectory_msgs::msg::JointTrajectory> msg)
+{
+  // msg is validated and owned by the controller
+  // A trajectory ends servoing and target following, it starts from the current joint state
+  servo_active_ = false;
+  target_active_ = false;
+
+  // Only a half of a both_arms plan without a stamp is synchronized. It starts after start_delay_ns_, or with the
+  // peer's half if that starts later. The peer's start was received already if it received its half first, otherwise
+  // it follows this one.
+  int64_t received_ns = rclcpp::Clock().now().nanoseconds();
+  int64_t stamp_ns = received_ns + start_delay_ns_;
+  bool synchronized = start_publisher_ && hardware_interface::utils::time_is_zero(msg->header.stamp) && 
+    msg->header.frame_id == SYNC_START_FRAME_ID;
+  if (synchronized) 
+  {
+    if (peer_start_.stamp_ns > stamp_ns && std::abs(peer_start_.received_ns - received_ns) <= start_sync_window_ns_) 
+    {
+      stamp_ns = peer_start_.stamp_ns;
+    }
+    msg->header.stamp = rclcpp::Time(stamp_ns);
+  }
+
+  // A trajectory stopped by a contact or given up to another controller is not continued, the new one starts from the
+  // current state
+  auto previous = published_trajectory_ && new_trajectory && !contact_stop_ && 
+    published_trajectory_.get() != taken_trajectory_ ? published_trajectory_ : nullptr;
+  auto trajectory = compile_trajectory(msg, previous);
+  taken_trajectory_ = nullptr;
+  sync_start_ns_ = synchronized ? to_trajectory_time(rclcpp::Time(stamp_ns)).nanoseconds() : 0;
+  publish_trajectory(trajectory);
+  contact_stop_ = false;
+  new_trajectory = true;
+
+  pending_start_ = PendingStart();
+  if (synchronized) 
+  {
+    pending_start_ = {msg, previous, trajectory, received_ns, stamp_ns};
+    publish_start({received_ns, stamp_ns, 0});
+  }
+  return trajectory;
+}
+
+std::shared_ptr<Trajectory>
+JointTrajectoryController::compile_trajectory(std::shared_ptr<trajectory_msgs::msg::JointTrajectory> msg,
+                                              const std::shared_ptr<Trajectory> & previous)
+{
+  // http://wiki.ros.org/joint_trajectory_controller/UnderstandingTrajectoryReplacement
+  // The trajectory is compiled to splines here, off the control thread. It is spliced onto previous, or starts from
+  // the current joint state if there is none.
+  for (size_t index = 0; index < registered_joint_state_handles_.size(); ++index) 
+  {
+    start_state_.positions[index] = registered_joint_state_handles_[index]->get_position();
+    start_state_.velocities[index] = registered_joint_state_handles_[index]->get_velocity();
+    start_state_.accelerations[index] = 0.0;
+  }
+
+  // Trajectories are timed on the trajectory clock, a stamp gives the start on the wall clock as of now
+  auto now = to_trajectory_time(rclcpp::Clock().now());
+  if (!hardware_interface::utils::time_is_zero(msg->header.stamp)) 
+  {
+    msg->header.stamp = to_trajectory_time(rclcpp::Time(msg->header.stamp));
+  }
+
+  static const Trajectory no_trajectory;
+  auto trajectory = trajectory_pool_.acquire();
+  if (!trajectory) 
+  {
+    RCLCPP_WARN(lifecycle_node_->get_logger(), "trajectory pool exhausted, allocating a trajectory");
+    trajectory = std::make_shared<Trajectory>();
+  }
+  trajectory->update(msg, previous ? *previous : no_trajectory, start_state_, now);
+  return trajectory;
+}
+
+void
+JointTrajectoryController::start_sync_callback(TrajectoryStart::UniquePtr msg)
+{
+  StartReport start;
+  start.received_ns = rclcpp::Time(msg->received).nanoseconds();
+  start.stamp_ns = rclcpp::Time(msg->stamp).nanoseconds();
+  start.started_ns = rclcpp::Time(msg->started).nanoseconds();
+  if (start.started_ns != 0) 
+  {
+    peer_started_ = start;
+    report_start_skew();
+    return;
+  }
+  peer_start_ = start;
+
+  // The half received first is delayed to the start of the peer's half, unless it is no longer pending
+  auto & pending = pending_start_;
+  if (!pending.trajectory || pending.trajectory != published_trajectory_ || contact_stop_ || 
+    pending.trajectory.get() == taken_trajectory_ || 
+    start.stamp_ns <= pending.stamp_ns || std::abs(start.received_ns - pending.received_ns) > start_sync_window_ns_) 
+  {
+    return;
+  }
+  int64_t now_ns = rclcpp::Clock().now().nanoseconds();
+  if (now_ns >= pending.stamp_ns) 
+  {
+    RCLCPP_WARN(lifecycle_node_->get_logger(), "start of the peer received %.1f ms after the trajectory started, "
+      "start_delay may be too short", (now_ns - pending.stamp_ns) * 1e-6);
+    return;
+  }
+
+  // Compiled again from the same state, the joints have not moved along it yet. The stamp is on the wall clock again.
+  pending.msg->header.stamp = rclcpp::Time(start.stamp_ns);
+  pending.stamp_ns = start.stamp_ns;
+  auto trajectory = compile_trajectory(pending.msg, pending.previous);
+  sync_start_ns_ = to_trajectory_time(rclcpp::Time(start.stamp_ns)).nanoseconds();
+  publish_trajectory(trajectory);
+  if (active_goal_ && active_goal_->trajectory == pending.trajectory) 
+  {
+    active_goal_->trajectory = trajectory;
+  }
+  pending.trajectory = trajectory;
+  publish_start({pending.received_ns, pending.stamp_ns, 0});
+}
+
+void
+JointTrajectoryController::publish_start(const StartReport & start)
+{
+  TrajectoryStart msg;
+  msg.received = rclcpp::Time(start.received_ns);
+  msg.stamp = rclcpp::Time(start.stamp_ns);
+  msg.started = rclcpp::Time(start.started_ns);
+  start_publisher_->publish(msg);
+}
+
+void
+JointTrajectoryController::publish_started()
+{
+  int64_t started_ns = sync_started_ns_.exchange(0);
+  if (started_ns == 0 || !start_publisher_ || !pending_start_.trajectory) 
+  {
+    return;
+  }
+  own_started_ = {pending_start_.received_ns, pending_start_.stamp_ns, started_ns};
+  publish_start(own_started_);
+  report_start_skew();
+}
+
+void
+JointTrajectoryController::report_start_skew()
+{
+  // Once both halves of the same start have been executed
+  if (own_started_.started_ns == 0 || own_started_.stamp_ns != peer_started_.stamp_ns) 
+  {
+    return;
+  }
+  double skew = (own_started_.started_ns - peer_started_.started_ns) * 1e-9;
+  std_msgs::msg::Float64 msg;
+  msg.data = skew;
+  start_skew_publisher_->publish(msg);
+  RCLCPP_INFO(lifecycle_node_->get_logger(), "trajectory started %.2f ms after the peer, %.2f ms after its stamp",
+    skew * 1e3, (own_started_.started_ns - own_started_.stamp_ns) * 1e-6);
+  own_started_ = StartReport();
+}
+
+void
+JointTrajectoryController::publish_state(const Trajectory & trajectory, int64_t time_ns, int64_t now_ns)
+{
+  // Realtime, the state vectors were sized in on_configure so nothing is allocated
+  if (rt_state_.trajectory != &trajectory) 
+  {
+    rt_state_.trajectory = &trajectory;
+    std::fill(rt_state_.peak_position_errors.begin(), rt_state_.peak_position_errors.end(), 0.0);
+    tracking_statistics_.start(now_ns);
+  }
+  rt_state_.time_ns = time_ns;
+
+  // Path errors count until the end of the trajectory, after it the goal tolerances apply
+  bool executing = time_ns < trajectory.end_time().nanoseconds();
+  size_t joint_num = registered_joint_state_handles_.size();
+  for (size_t index = 0; index < joint_num; ++index) 
+  {
+    rt_state_.desired_positions[index] = sampled_state_.positions[index];
+    rt_state_.desired_velocities[index] = speed_scale_ * sampled_state_.velocities[index];
+    rt_state_.actual_positions[index] = registered_joint_state_handles_[index]->get_position();
+    rt_state_.actual_velocities[index] = registered_joint_state_handles_[index]->get_velocity();
+    if (executing) 
+    {
+      double error = std::abs(rt_state_.desired_positions[index] - rt_state_.actual_positions[index]);
+      rt_state_.peak_position_errors[index] = std::max(rt_state_.peak_position_errors[index], error);
+    }
+    if (index < tracking_errors_.size()) 
+    {
+      tracking_errors_[index] = rt_state_.desired_positions[index] - rt_state_.actual_positions[index];
+    }
+  }
+  tracking_statistics_.add_sample(now_ns, tracking_errors_, !executing);
+  rt_state_.tracking = tracking_statistics_.summary();
+  state_buffer_.write_from_rt(rt_state_);
+}
+
+rclcpp_action::GoalResponse
+JointTrajectoryController::handle_goal(const rclcpp_action::GoalUUID & uuid,
+                                       std::shared_ptr<const FollowJointTrajectory::Goal> goal)
+{
+  (void) uuid;
+  auto logger = lifecycle_node_->get_logger();
+
+  if (!subscriber_is_active_ || is_stopped) 
+  {
+    RCLCPP_WARN(logger, "rejecting trajectory goal, the controller is not active or is stopped");
+    return rclcpp_action::GoalResponse::REJECT;
+  }
+  (void) goal;  // Validated once accepted, so a rejection comes with a result
+  return rclcpp_action::GoalResponse::ACCEPT_AND_EXECUTE;
+}
+
+rclcpp_action::CancelResponse
+JointTrajectoryController::handle_cancel(const std::shared_ptr<GoalHandle> goal_handle)
+{
+  // The goal is stopped and reported canceled by the monitor
+  (void) goal_handle;
+  return rclcpp_action::CancelResponse::ACCEPT;
+}
+
+void
+JointTrajectoryController::handle_accepted(const std::shared_ptr<GoalHandle> goal_handle)
+{
+  if (active_goal_) 
+  {
+    finish_active_goal(false, GOAL_PREEMPTED, "preempted by a new goal");
+  }
+
+  const auto & goal = *goal_handle->get_goal();
+  auto validated = std::make_shared<trajectory_msgs::msg::JointTrajectory>();
+  std::string error;
+  auto validation = validate_trajectory(goal.trajectory, joint_names_, limits_, *validated, error);
+  if (validation != TrajectoryValidation::VALID) 
+  {
+    RCLCPP_WARN(lifecycle_node_->get_logger(), "trajectory goal rejected, %s", error.c_str());
+    auto result = std::make_shared<FollowJointTrajectory::Result>();
+    result->error_code = validation == TrajectoryValidation::INVALID_JOINTS ?  //if
+      FollowJointTrajectory::Result::INVALID_JOINTS :  //then
+      FollowJointTrajectory::Result::INVALID_GOAL;  //else
+    result->error_string = error;
+    goal_handle->abort(result);
+    return;
+  }
+
+  auto active_goal = std::make_shared<ActiveGoal>();
+  active_goal->handle = goal_handle;
+  active_goal->path_tolerances = resolve_tolerances(goal.path_tolerance, default_path_tolerance_);
+  active_goal->goal_tolerances = resolve_tolerances(goal.goal_tolerance, default_goal_tolerance_);
+  int64_t goal_time_tolerance_ns = rclcpp::Duration(goal.goal_time_tolerance).nanoseconds();
+  active_goal->goal_time_tolerance_ns = goal_time_tolerance_ns > 0 ?  //if
+    goal_time_tolerance_ns :  //then
+    static_cast<int64_t>(default_goal_time_tolerance_ * 1e9);  //else
+
+  active_goal->feedback = std::make_shared<FollowJointTrajectory::Feedback>();
+  active_goal->feedback->joint_names = joint_names_;
+  for (auto point : {&active_goal->feedback->desired, &active_goal->feedback->actual, &active_goal->feedback->error}) 
+  {
+    point->positions.resize(joint_names_.size());
+    point->velocities.resize(joint_names_.size());
+  }
+
+  active_goal->trajectory = execute_trajectory(validated);
+  active_goal_ = active_goal;
+}
+
+std::vector<double>
+JointTrajectoryController::resolve_tolerances(const std::vector<control_msgs::msg::JointTolerance> & tolerances,
+                                              double default_tolerance) const
+{
+  // As in control_msgs: a positive tolerance is used, 0 means the default and a negative one no tolerance
+  const double unchecked = std::numeric_limits<double>::infinity();
+  std::vector<double> resolved(joint_names_.size(), default_tolerance > 0.0 ? default_tolerance : unchecked);
+  for (const auto & tolerance : tolerances) 
+  {
+    auto joint = std::find(joint_names_.begin(), joint_names_.end(), tolerance.name);
+    if (joint != joint_names_.end() && tolerance.position != 0.0) 
+    {
+      resolved[std::distance(joint_names_.begin(), joint)] = tolerance.position > 0.0 ? tolerance.position : unchecked;
+    }
+  }
+  return resolved;
+}
+
+void
+JointTrajectoryController::monitor_active_goal()
+{
+  if (!active_goal_) 
+  {
+    return;
+  }
+
+  if (active_goal_->handle->is_canceling()) 
+  {
+    if (published_trajectory_ == active_goal_->trajectory) 
+    {
+      publish_trajectory(nullptr);
+      new_trajectory = false;
+    }
+    auto result = std::make_shared<FollowJointTrajectory::Result>();
+    result->error_string = "canceled";
+    active_goal_->handle->canceled(result);
+    active_goal_.reset();
+    return;
+  }
+
+  // Replaced by a msg on the topic, or stopped
+  if (published_trajectory_ != active_goal_->trajectory) 
+  {
+    finish_active_goal(false, GOAL_PREEMPTED, "replaced or stopped");
+    return;
+  }
+  if (taken_trajectory_ == active_goal_->trajectory.get()) 
+  {
+    finish_active_goal(false, GOAL_PREEMPTED, "taken over by another controller");
+    return;
+  }
+
+  // Nothing to report until the control loop samples the trajectory
+  const auto & state = state_buffer_.read_from_non_rt();
+  if (state.trajectory != active_goal_->trajectory.get()) 
+  {
+    return;
+  }
+
+  auto & feedback = *active_goal_->feedback;
+  feedback.header.stamp = lifecycle_node_->now();
+  for (size_t index = 0; index < joint_names_.size(); ++index) 
+  {
+    feedback.desired.positions[index] = state.desired_positions[index];
+    feedback.desired.velocities[index] = state.desired_velocities[index];
+    feedback.actual.positions[index] = state.actual_positions[index];
+    feedback.actual.velocities[index] = state.actual_velocities[index];
+    feedback.error.positions[index] = state.desired_positions[index] - state.actual_positions[index];
+    feedback.error.velocities[index] = state.desired_velocities[index] - state.actual_velocities[index];
+  }
+  active_goal_->handle->publish_feedback(active_goal_->feedback);
+
+  for (size_t index = 0; index < joint_names_.size(); ++index) 
+  {
+    if (state.peak_position_errors[index] > active_goal_->path_tolerances[index]) 
+    {
+      // The joints decelerate to rest
+      publish_trajectory(nullptr);
+      new_trajectory = false;
+      finish_active_goal(false, FollowJointTrajectory::Result::PATH_TOLERANCE_VIOLATED,
+        joint_names_[index] + " deviated " + std::to_string(state.peak_position_errors[index]) + 
+        " rad from the path");
+      return;
+    }
+  }
+
+  int64_t end_ns = active_goal_->trajectory->end_time().nanoseconds();
+  if (state.time_ns < end_ns) 
+  {
+    return;
+  }
+  for (size_t index = 0; index < joint_names_.size(); ++index) 
+  {
+    if (std::abs(feedback.error.positions[index]) > active_goal_->goal_tolerances[index]) 
+    {
+      if (state.time_ns > end_ns + active_goal_->goal_time_tolerance_ns) 
+      {
+        finish_active_goal(false, FollowJointTrajectory::Result::GOAL_TOLERANCE_VIOLATED,
+          joint_names_[index] + " is " + std::to_string(feedback.error.positions[index]) + " rad from the goal");
+      }
+      return;
+    }
+  }
+  finish_active_goal(true, FollowJointTrajectory::Result::SUCCESSFUL, "");
+}
+
+void
+JointTrajectoryController::finish_active_goal(bool success, int32_t error_code, const std::string & error_string)
+{
+  auto result = std::make_shared<FollowJointTrajectory::Result>();
+  result->error_code = error_code;
+  result->error_string = error_string;
+
+  // The tracking error of the goal is reported with the result, if it was executed
+  const auto & state = state_buffer_.read_from_non_rt();
+  if (state.trajectory == active_goal_->trajectory.get()) 
+  {
+    publish_tracking_stats(state.tracking);
+    result->error_string += (error_string.empty() ? "" : ", ") + describe_tracking(state.tracking);
+  }
+
+  if (success) 
+  {
+    active_goal_->handle->succeed(result);
+  } 
+  else 
+  {
+    RCLCPP_WARN(lifecycle_node_->get_logger(), "trajectory goal aborted: %s", error_string.c_str());
+    active_goal_->handle->abort(result);
+  }
+  active_goal_.reset();
+}
+
+void
+JointTrajectoryController::publish_tracking_stats(const control_utils::TrackingSummary & summary)
+{
+  // Only new samples are published
+  if (summary.samples == 0 || 
+      (summary.segment == tracking_msg_.segment && summary.samples == tracking_msg_.samples)) 
+  {
+    return;
+  }
+  to_tracking_error_stats(summary, joint_names_, tracking_msg_);
+  tracking_publisher_->publish(tracking_msg_);
+}
+
+std::string
+JointTrajectoryController::describe_tracking(const control_utils::TrackingSummary & summary) const
+{
+  // Worst joint of each statistic
+  size_t worst = 0;
+  double rms = 0.0, goal = 0.0, settling = 0.0;
+  for (size_t index = 0; index < summary.size; ++index) 
+  {
+    worst = summary.max_error[index] > summary.max_error[worst] ? index : worst;
+    rms = std::max(rms, summary.rms_error[index]);
+    goal = std::max(goal, std::abs(summary.goal_error[index]));
+    settling = (settling < 0.0 || summary.settling_time[index] < 0.0) ? -1.0 : 
+      std::max(settling, summary.settling_time[index]);
+  }
+
+  char description[256];
+  int length = std::snprintf(description, sizeof(description), 
+    "tracking error: max %.4f rad (%s), rms %.4f rad, at goal %.4f rad", summary.max_error[worst], 
+    worst < joint_names_.size() ? joint_names_[worst].c_str() : "", rms, goal);
+  if (summary.goal_ns >= 0 && length > 0 && static_cast<size_t>(length) < sizeof(description)) 
+  {
+    if (settling < 0.0) 
+    {
+      std::snprintf(description + length, sizeof(description) - length, ", not settled");
+    }
+    else 
+    {
+      std::snprintf(description + length, sizeof(description) - length, ", settled in %.3f s", settling);
+    }
+  }
+  return description;
+}
+
 }  // namespace ros_controllers
 
 #include "class_loader/register_macro.hpp"
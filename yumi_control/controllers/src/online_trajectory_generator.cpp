@@ -0,0 +1,138 @@
+// Copyright 2020 Markus Bjønnes and Marius Nilsen.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <controllers/online_trajectory_generator.hpp>
+
+
+namespace ros_controllers
+{
+
+void
+OnlineTrajectoryGenerator::resize(size_t dof)
+{
+  state_.resize(dof);
+  target_positions_.assign(dof, 0.0);
+  target_velocities_.assign(dof, 0.0);
+  min_positions_.assign(dof, -std::numeric_limits<double>::infinity());
+  max_positions_.assign(dof, std::numeric_limits<double>::infinity());
+  max_velocities_.assign(dof, std::numeric_limits<double>::infinity());
+}
+
+void
+OnlineTrajectoryGenerator::set_limits(const TrajectoryLimits & limits, double max_velocity, double max_acceleration,
+                                      double max_jerk)
+{
+  for (size_t index = 0; index < max_velocities_.size(); ++index) 
+  {
+    if (!limits.min_positions.empty()) 
+    {
+      min_positions_[index] = limits.min_positions[index];
+    }
+    if (!limits.max_positions.empty()) 
+    {
+      max_positions_[index] = limits.max_positions[index];
+    }
+    max_velocities_[index] = limits.max_velocities.empty() ? max_velocity :
+      std::min(max_velocity, limits.max_velocities[index]);
+  }
+  max_acceleration_ = max_acceleration;
+  max_jerk_ = max_jerk;
+}
+
+void
+OnlineTrajectoryGenerator::reset(const std::vector<double> & positions, const std::vector<double> & velocities,
+                                 const std::vector<double> & accelerations)
+{
+  for (size_t index = 0; index < state_.positions.size(); ++index) 
+  {
+    state_.positions[index] = positions[index];
+    state_.velocities[index] = velocities[index];
+    state_.accelerations[index] = std::min(std::max(accelerations[index], -max_acceleration_), max_acceleration_);
+    target_positions_[index] = positions[index];
+    target_velocities_[index] = 0.0;
+  }
+}
+
+void
+OnlineTrajectoryGenerator::set_target(size_t joint, double position, double velocity)
+{
+  target_positions_[joint] = std::min(std::max(position, min_positions_[joint]), max_positions_[joint]);
+  target_velocities_[joint] = std::min(std::max(velocity, -max_velocities_[joint]), max_velocities_[joint]);
+}
+
+void
+OnlineTrajectoryGenerator::update(double dt)
+{
+  if (!(dt > 0.0)) 
+  {
+    return;
+  }
+
+  // Close to the target the square root laws of the cascade are too steep to be followed in steps of dt. There it is
+  // linear instead, with the velocity settling over 5 cycles and the position 4 times slower.
+  const double velocity_gain = 0.2 / dt;
+  const double position_gain = 0.25 * velocity_gain;
+
+  for (size_t index = 0; index < state_.positions.size(); ++index) 
+  {
+    double & position = state_.positions[index];
+    double & velocity = state_.velocities[index];
+    double & acceleration = state_.accelerations[index];
+    double target_velocity = target_velocities_[index];
+
+    // Distance to the target, less the distance covered while the velocity follows the desired one
+    double distance = target_positions_[index] - position;
+    double lag = 0.5 * (max_acceleration_ / max_jerk_ + 1.0 / velocity_gain);
+    double lead = distance - (velocity - target_velocity) * lag;
+    distance = (lead * distance > 0.0) ? lead : 0.0;
+
+    // Velocity relative to the target from which the joint can still brake onto it
+    double approach = std::min(braking_velocity(std::abs(distance)), position_gain * std::abs(distance));
+    double desired_velocity = std::min(std::max(target_velocity + std::copysign(approach, distance),
+                                                -max_velocities_[index]), max_velocities_[index]);
+
+    // Acceleration towards it, from the velocity reached if the acceleration is ramped down to 0 now
+    double velocity_error = desired_velocity - velocity - acceleration * std::abs(acceleration) / (2.0 * max_jerk_);
+    double desired_acceleration = std::copysign(std::min({max_acceleration_, 
+                                                          std::sqrt(2.0 * max_jerk_ * std::abs(velocity_error)),
+                                                          velocity_gain * std::abs(velocity_error)}),
+                                                velocity_error);
+    double jerk = std::min(std::max((desired_acceleration - acceleration) / dt, -max_jerk_), max_jerk_);
+
+    // Exact for constant jerk over the cycle
+    position += dt * (velocity + dt * (0.5 * acceleration + dt * jerk / 6.0));
+    velocity += dt * (acceleration + 0.5 * dt * jerk);
+    acceleration += dt * jerk;
+  }
+}
+
+double
+OnlineTrajectoryGenerator::braking_velocity(double distance) const
+{
+  // Braking from v with the acceleration ramped to its peak and back takes v sqrt(v / J) while the peak stays below
+  // A, i.e. up to A^3 / J^2, and v (v / A + A / J) / 2 with a phase at A beyond
+  double ramp_distance = max_acceleration_ * max_acceleration_ * max_acceleration_ / (max_jerk_ * max_jerk_);
+  if (distance <= ramp_distance) 
+  {
+    return std::cbrt(distance * distance * max_jerk_);
+  }
+  double ramp_velocity = max_acceleration_ * max_acceleration_ / max_jerk_;
+  return 0.5 * (-ramp_velocity + std::sqrt(ramp_velocity * ramp_velocity + 8.0 * max_acceleration_ * distance));
+}
+
+}  // namespace ros_controllers
@@ -1,86 +1,489 @@
-
 #include <controllers/trajectory.hpp>
+#include <algorithm>
+#include <cmath>
 #include <memory>
-#include "hardware_interface/macros.hpp"
+#include <unordered_map>
 #include "hardware_interface/utils/time_utils.hpp"
 #include "rclcpp/clock.hpp"
+#include "rclcpp/duration.hpp"
 
 namespace ros_controllers
 {
 
 using hardware_interface::utils::time_is_zero;
-using hardware_interface::utils::time_less_than_equal;
-using hardware_interface::utils::time_add;
-using hardware_interface::utils::time_less_than;
+
+namespace
+{
+
+// Mean velocities between points may exceed the limits by this factor, for rounding of time_from_start
+constexpr double MEAN_VELOCITY_MARGIN = 1.01;
+
+bool all_finite(const std::vector<double> & values)
+{
+  return std::all_of(values.begin(), values.end(), [](double value) { return std::isfinite(value); });
+}
+
+}  // namespace
+
+TrajectoryValidation
+validate_trajectory(const trajectory_msgs::msg::JointTrajectory & joint_trajectory,
+                    const std::vector<std::string> & joint_names, const TrajectoryLimits & limits,
+                    trajectory_msgs::msg::JointTrajectory & validated, std::string & error)
+{
+  const size_t dof = joint_names.size();
+
+  // Position of each controller joint in the msg
+  if (joint_trajectory.joint_names.size() != dof) 
+  {
+    error = "expected " + std::to_string(dof) + " joints, got " + std::to_string(joint_trajectory.joint_names.size());
+    return TrajectoryValidation::INVALID_JOINTS;
+  }
+  std::unordered_map<std::string, size_t> msg_index;
+  for (size_t index = 0; index < dof; ++index) 
+  {
+    msg_index.emplace(joint_trajectory.joint_names[index], index);
+  }
+  std::vector<size_t> order(dof);
+  for (size_t index = 0; index < dof; ++index) 
+  {
+    auto joint = msg_index.find(joint_names[index]);
+    if (joint == msg_index.end()) 
+    {
+      error = "joint " + joint_names[index] + " missing";
+      return TrajectoryValidation::INVALID_JOINTS;
+    }
+    order[index] = joint->second;
+  }
+
+  if (joint_trajectory.points.empty()) 
+  {
+    error = "no points";
+    return TrajectoryValidation::INVALID_POINTS;
+  }
+
+  validated.header = joint_trajectory.header;
+  validated.joint_names = joint_names;
+  validated.points.resize(joint_trajectory.points.size());
+  auto reorder = [&order, dof](const std::vector<double> & values, std::vector<double> & reordered)
+    {
+      reordered.resize(values.empty() ? 0 : dof);
+      for (size_t index = 0; index < reordered.size(); ++index) 
+      {
+        reordered[index] = values[order[index]];
+      }
+    };
+
+  for (size_t k = 0; k < joint_trajectory.points.size(); ++k) 
+  {
+    const auto & point = joint_trajectory.points[k];
+    auto & validated_point = validated.points[k];
+    std::string where = "point " + std::to_string(k) + ": ";
+
+    if (point.positions.size() != dof || 
+      (!point.velocities.empty() && point.velocities.size() != dof) ||
+      (!point.accelerations.empty() && point.accelerations.size() != dof))
+    {
+      error = where + "positions, velocities or accelerations do not match the joints";
+      return TrajectoryValidation::INVALID_POINTS;
+    }
+    if (!all_finite(point.positions) || !all_finite(point.velocities) || !all_finite(point.accelerations)) 
+    {
+      error = where + "non-finite value";
+      return TrajectoryValidation::INVALID_POINTS;
+    }
+    int64_t time_ns = rclcpp::Duration(point.time_from_start).nanoseconds();
+    int64_t previous_ns = k > 0 ? rclcpp::Duration(joint_trajectory.points[k - 1].time_from_start).nanoseconds() : 0;
+    if (time_ns < 0 || (k > 0 && time_ns <= previous_ns)) 
+    {
+      error = where + "time_from_start does not increase";
+      return TrajectoryValidation::INVALID_POINTS;
+    }
+
+    reorder(point.positions, validated_point.positions);
+    reorder(point.velocities, validated_point.velocities);
+    reorder(point.accelerations, validated_point.accelerations);
+    validated_point.time_from_start = point.time_from_start;
+
+    for (size_t index = 0; index < dof; ++index) 
+    {
+      double position = validated_point.positions[index];
+      if ((!limits.min_positions.empty() && position < limits.min_positions[index]) ||
+        (!limits.max_positions.empty() && position > limits.max_positions[index]))
+      {
+        error = where + joint_names[index] + " position " + std::to_string(position) + " outside limits";
+        return TrajectoryValidation::INVALID_POINTS;
+      }
+      if (limits.max_velocities.empty()) 
+      {
+        continue;
+      }
+      double max_velocity = limits.max_velocities[index];
+      if (!validated_point.velocities.empty() && std::abs(validated_point.velocities[index]) > max_velocity) 
+      {
+        error = where + joint_names[index] + " velocity " + std::to_string(validated_point.velocities[index]) + 
+          " exceeds limit";
+        return TrajectoryValidation::INVALID_POINTS;
+      }
+      if (k > 0) 
+      {
+        double distance = std::abs(position - validated.points[k - 1].positions[index]);
+        if (distance > MEAN_VELOCITY_MARGIN * max_velocity * (time_ns - previous_ns) * 1e-9) 
+        {
+          error = where + joint_names[index] + " moves faster than its velocity limit from the previous point";
+          return TrajectoryValidation::INVALID_POINTS;
+        }
+      }
+    }
+  }
+
+  error.clear();
+  return TrajectoryValidation::VALID;
+}
 
 Trajectory::Trajectory()
-: trajectory_start_time_(0)
 {}
 
 Trajectory::Trajectory(std::shared_ptr<trajectory_msgs::msg::JointTrajectory> joint_trajectory)
-: trajectory_msg_(joint_trajectory),
-  trajectory_start_time_(time_is_zero(joint_trajectory->header.stamp) ?  //if
-    rclcpp::Clock().now() : //then
-    static_cast<rclcpp::Time>(joint_trajectory->header.stamp)) //else
-{}
+{
+  update(joint_trajectory);
+}
+
+int64_t
+Trajectory::start_time_ns(const trajectory_msgs::msg::JointTrajectory & joint_trajectory, int64_t now_ns) const
+{
+  return time_is_zero(joint_trajectory.header.stamp) ?  //if
+    now_ns :  //then
+    rclcpp::Time(joint_trajectory.header.stamp).nanoseconds();  //else
+}
 
 void
 Trajectory::update(std::shared_ptr<trajectory_msgs::msg::JointTrajectory> joint_trajectory)
 {
-  trajectory_msg_ = joint_trajectory;
-  trajectory_start_time_ = (time_is_zero(joint_trajectory->header.stamp) ? //if
-    rclcpp::Clock().now() :  //then
-    static_cast<rclcpp::Time>(joint_trajectory->header.stamp));  //else
+  compile(*joint_trajectory, start_time_ns(*joint_trajectory, rclcpp::Clock().now().nanoseconds()), {}, {});
+}
+
+void
+Trajectory::update(std::shared_ptr<trajectory_msgs::msg::JointTrajectory> joint_trajectory,
+                   const TrajectoryState & current_state)
+{
+  int64_t start_ns = start_time_ns(*joint_trajectory, rclcpp::Clock().now().nanoseconds());
+  compile(*joint_trajectory, start_ns, {start_ns}, {current_state});
+}
+
+void
+Trajectory::update(std::shared_ptr<trajectory_msgs::msg::JointTrajectory> joint_trajectory,
+                   const Trajectory & previous, const TrajectoryState & current_state, const rclcpp::Time & now)
+{
+  int64_t now_ns = now.nanoseconds();
+  int64_t start_ns = start_time_ns(*joint_trajectory, now_ns);
+
+  TrajectoryState state;
+  state.resize(current_state.positions.size());
+  if (previous.dof() != state.positions.size() || !previous.sample_at(now, state))
+  {
+    compile(*joint_trajectory, start_ns, {start_ns}, {current_state});
+    return;
+  }
+
+  // Splice at now, and follow previous until the new trajectory starts
+  std::vector<int64_t> prefix_ns = {now_ns};
+  std::vector<TrajectoryState> prefix_states = {state};
+  if (start_ns >= now_ns + MIN_SEGMENT_NS)
+  {
+    for (auto knot_ns : previous.knot_ns_)
+    {
+      if (knot_ns >= now_ns + MIN_SEGMENT_NS && knot_ns <= start_ns - MIN_SEGMENT_NS)
+      {
+        previous.sample_at(rclcpp::Time(knot_ns), state);
+        prefix_ns.push_back(knot_ns);
+        prefix_states.push_back(state);
+      }
+    }
+    previous.sample_at(rclcpp::Time(start_ns), state);
+    prefix_ns.push_back(start_ns);
+    prefix_states.push_back(state);
+  }
+
+  compile(*joint_trajectory, start_ns, prefix_ns, prefix_states);
+  start_ns_ = now_ns;
 }
 
-TrajectoryPointConstIter
-Trajectory::sample(const rclcpp::Time & sample_time)
+void
+Trajectory::compile(const trajectory_msgs::msg::JointTrajectory & joint_trajectory, int64_t start_ns,
+                    const std::vector<int64_t> & prefix_ns, const std::vector<TrajectoryState> & prefix_states)
 {
-  // skip if current time hasn't reached traj time of the first msg yet
-  if (time_less_than(sample_time, trajectory_start_time_)) 
+  cursor_ = 0;
+  knot_ns_.clear();
+  coefficients_.clear();
+  end_positions_.clear();
+  knot_positions_.clear();
+  knot_velocities_.clear();
+  knot_accelerations_.clear();
+  knot_detail_.clear();
+  start_ns_ = start_ns;
+
+  if (!prefix_states.empty())
+  {
+    dof_ = prefix_states.front().positions.size();
+  }
+  else
+  {
+    dof_ = joint_trajectory.points.empty() ? 0 : joint_trajectory.points.front().positions.size();
+  }
+  if (dof_ == 0)
+  {
+    return;
+  }
+
+  // Knots, in time order, with the state of every joint
+  auto & positions = knot_positions_;
+  auto & velocities = knot_velocities_;
+  auto & accelerations = knot_accelerations_;
+  // Missing velocities or accelerations are zero
+  auto add_knot = [&](int64_t time_ns, const std::vector<double> & p, const std::vector<double> & v,
+                      const std::vector<double> & a)
+    {
+      knot_ns_.push_back(time_ns);
+      positions.insert(positions.end(), p.begin(), p.end());
+      if (v.size() == dof_)
+      {
+        velocities.insert(velocities.end(), v.begin(), v.end());
+      }
+      else
+      {
+        velocities.insert(velocities.end(), dof_, 0.0);
+      }
+      if (a.size() == dof_)
+      {
+        accelerations.insert(accelerations.end(), a.begin(), a.end());
+      }
+      else
+      {
+        accelerations.insert(accelerations.end(), dof_, 0.0);
+      }
+    };
+
+  for (size_t k = 0; k < prefix_ns.size(); ++k)
+  {
+    add_knot(prefix_ns[k], prefix_states[k].positions, prefix_states[k].velocities, prefix_states[k].accelerations);
+  }
+
+  // The detail of the msg points is that of the least detailed one, prefix knots have full state
+  enum KnotDetail { POSITION = 0, VELOCITY = 1, ACCELERATION = 2 };
+  auto & detail = knot_detail_;
+  detail.assign(knot_ns_.size(), ACCELERATION);
+  bool has_velocities = true;
+  bool has_accelerations = true;
+  for (const auto & point : joint_trajectory.points)
   {
-    return end();
+    int64_t time_ns = start_ns_ + rclcpp::Duration(point.time_from_start).nanoseconds();
+    if (point.positions.size() != dof_ || (!knot_ns_.empty() && time_ns < knot_ns_.back() + MIN_SEGMENT_NS))
+    {
+      continue;
+    }
+    has_velocities = has_velocities && point.velocities.size() == dof_;
+    has_accelerations = has_accelerations && point.accelerations.size() == dof_;
+    add_knot(time_ns, point.positions, point.velocities, point.accelerations);
+  }
+  if (knot_ns_.empty())
+  {
+    return;
+  }
+  int msg_detail = has_velocities ? (has_accelerations ? ACCELERATION : VELOCITY) : POSITION;
+  detail.resize(knot_ns_.size(), msg_detail);
+
+  // The segment from the last prefix knot to the first msg point is quintic as well, so the splice is continuous. The
+  // derivatives the msg leaves out at that point are taken from the segment after it, at rest if there is none.
+  size_t first = prefix_ns.size();
+  if (first > 0 && first < knot_ns_.size() && msg_detail != ACCELERATION)
+  {
+    bool last = first + 1 == knot_ns_.size();
+    double T = last ? 0.0 : (knot_ns_[first + 1] - knot_ns_[first]) * 1e-9;
+    for (size_t j = 0; j < dof_; ++j)
+    {
+      double h = last ? 0.0 : positions[(first + 1) * dof_ + j] - positions[first * dof_ + j];
+      double & v0 = velocities[first * dof_ + j];
+      if (msg_detail == POSITION)
+      {
+        v0 = last ? 0.0 : h / T;
+      }
+      double v1 = last ? 0.0 : velocities[(first + 1) * dof_ + j];
+      bool cubic = msg_detail == VELOCITY && !last;
+      accelerations[first * dof_ + j] = cubic ? 2 * (3 * h - (2 * v0 + v1) * T) / (T * T) : 0.0;
+    }
+    detail[first] = ACCELERATION;
   }
 
-  // time_from_start + trajectory time is the expected arrival time of trajectory
-  for (auto point = begin(); point != end(); ++point) 
+  // One polynomial per segment and joint, in local time tau = t - knot_ns_[s]
+  size_t segments = knot_ns_.size() - 1;
+  coefficients_.assign(segments * COEFFICIENTS * dof_, 0.0);
+  for (size_t s = 0; s < segments; ++s)
   {
-    auto start_time = time_add(trajectory_start_time_, point->time_from_start);
-    if (time_less_than(sample_time, start_time)) 
+    double T = (knot_ns_[s + 1] - knot_ns_[s]) * 1e-9;
+    int order = std::min(detail[s], detail[s + 1]);
+    double * c = &coefficients_[s * COEFFICIENTS * dof_];
+    for (size_t j = 0; j < dof_; ++j)
     {
-      return point;
+      double p0 = positions[s * dof_ + j], p1 = positions[(s + 1) * dof_ + j];
+      double v0 = velocities[s * dof_ + j], v1 = velocities[(s + 1) * dof_ + j];
+      double a0 = accelerations[s * dof_ + j], a1 = accelerations[(s + 1) * dof_ + j];
+      double h = p1 - p0;
+
+      c[j] = p0;
+      if (order == ACCELERATION)
+      {
+        c[1 * dof_ + j] = v0;
+        c[2 * dof_ + j] = 0.5 * a0;
+        c[3 * dof_ + j] = (20 * h - (8 * v1 + 12 * v0) * T - (3 * a0 - a1) * T * T) / (2 * T * T * T);
+        c[4 * dof_ + j] = (-30 * h + (14 * v1 + 16 * v0) * T + (3 * a0 - 2 * a1) * T * T) / (2 * T * T * T * T);
+        c[5 * dof_ + j] = (12 * h - 6 * (v1 + v0) * T + (a1 - a0) * T * T) / (2 * T * T * T * T * T);
+      }
+      else if (order == VELOCITY)
+      {
+        c[1 * dof_ + j] = v0;
+        c[2 * dof_ + j] = (3 * h - (2 * v0 + v1) * T) / (T * T);
+        c[3 * dof_ + j] = (-2 * h + (v0 + v1) * T) / (T * T * T);
+      }
+      else
+      {
+        c[1 * dof_ + j] = h / T;
+      }
     }
   }
 
-  return end();
+  end_positions_.assign(positions.end() - dof_, positions.end());
 }
 
-TrajectoryPointConstIter
-Trajectory::begin() const
+void
+Trajectory::evaluate(size_t segment, int64_t time_ns, TrajectoryState & state) const
 {
-  // THROW_ON_NULLPTR(trajectory_msg_)
+  double T = (knot_ns_[segment + 1] - knot_ns_[segment]) * 1e-9;
+  double tau = std::min(std::max((time_ns - knot_ns_[segment]) * 1e-9, 0.0), T);
+  const double * c = &coefficients_[segment * COEFFICIENTS * dof_];
+  const double * c1 = c + dof_;
+  const double * c2 = c1 + dof_;
+  const double * c3 = c2 + dof_;
+  const double * c4 = c3 + dof_;
+  const double * c5 = c4 + dof_;
+
+  for (size_t j = 0; j < dof_; ++j)
+  {
+    state.positions[j] = c[j] + tau * (c1[j] + tau * (c2[j] + tau * (c3[j] + tau * (c4[j] + tau * c5[j]))));
+    state.velocities[j] = c1[j] + tau * (2 * c2[j] + tau * (3 * c3[j] + tau * (4 * c4[j] + tau * 5 * c5[j])));
+    state.accelerations[j] = 2 * c2[j] + tau * (6 * c3[j] + tau * (12 * c4[j] + tau * 20 * c5[j]));
+  }
+}
+
+void
+Trajectory::hold_end(TrajectoryState & state) const
+{
+  std::copy(end_positions_.begin(), end_positions_.end(), state.positions.begin());
+  std::fill_n(state.velocities.begin(), dof_, 0.0);
+  std::fill_n(state.accelerations.begin(), dof_, 0.0);
+}
+
+bool
+Trajectory::sample(const rclcpp::Time & sample_time, TrajectoryState & state)
+{
+  int64_t time_ns = sample_time.nanoseconds();
+  if (is_empty() || time_ns < start_ns_)
+  {
+    return false;
+  }
+
+  // Past the end, hold the last point
+  if (time_ns >= knot_ns_.back() || segment_count() == 0)
+  {
+    hold_end(state);
+    return true;
+  }
 
-  return trajectory_msg_->points.begin();
+  if (time_ns < knot_ns_[cursor_])
+  {
+    cursor_ = 0;
+  }
+  while (time_ns >= knot_ns_[cursor_ + 1])
+  {
+    cursor_++;
+  }
+
+  evaluate(cursor_, time_ns, state);
+  return true;
 }
 
-TrajectoryPointConstIter
-Trajectory::end() const
+bool
+Trajectory::sample_at(const rclcpp::Time & sample_time, TrajectoryState & state) const
 {
-  // THROW_ON_NULLPTR(trajectory_msg_)
+  int64_t time_ns = sample_time.nanoseconds();
+  if (is_empty() || time_ns < start_ns_)
+  {
+    return false;
+  }
+
+  if (time_ns >= knot_ns_.back() || segment_count() == 0)
+  {
+    hold_end(state);
+    return true;
+  }
 
-  return trajectory_msg_->points.end();
+  // Before the first knot the segment is evaluated at its start
+  auto next_knot = std::upper_bound(knot_ns_.begin(), knot_ns_.end(), time_ns);
+  evaluate(std::max<std::ptrdiff_t>(std::distance(knot_ns_.begin(), next_knot) - 1, 0), time_ns, state);
+  return true;
 }
 
 rclcpp::Time
 Trajectory::time_from_start() const
 {
-  return trajectory_start_time_;
+  return rclcpp::Time(start_ns_);
+}
+
+rclcpp::Time
+Trajectory::end_time() const
+{
+  return rclcpp::Time(knot_ns_.empty() ? start_ns_ : knot_ns_.back());
 }
 
 bool
 Trajectory::is_empty() const
 {
-  return !trajectory_msg_;
+  return knot_ns_.empty();
+}
+
+void
+Trajectory::reserve(size_t dof, size_t knots)
+{
+  knot_ns_.reserve(knots);
+  coefficients_.reserve(knots * COEFFICIENTS * dof);
+  end_positions_.reserve(dof);
+  knot_positions_.reserve(knots * dof);
+  knot_velocities_.reserve(knots * dof);
+  knot_accelerations_.reserve(knots * dof);
+  knot_detail_.reserve(knots);
+}
+
+void
+TrajectoryPool::allocate(size_t size, size_t dof, size_t max_points)
+{
+  trajectories_.resize(size);
+  for (auto & trajectory : trajectories_) 
+  {
+    trajectory = std::make_shared<Trajectory>();
+    trajectory->reserve(dof, max_points);
+  }
+}
+
+std::shared_ptr<Trajectory>
+TrajectoryPool::acquire()
+{
+  for (const auto & trajectory : trajectories_) 
+  {
+    if (trajectory.use_count() == 1) 
+    {
+      return trajectory;
+    }
+  }
+  return nullptr;
 }
 
-}  // namespace ros_controllers
\ No newline at end of file
+}  // namespace ros_controllers
@@ -0,0 +1,34 @@
+#ifndef ROS2_CONTROL_UTILS__JOINT_ORDER_HASH_HPP
+#define ROS2_CONTROL_UTILS__JOINT_ORDER_HASH_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace control_utils
+{
+
+/**
+ * @brief 32 bit FNV-1a hash of an ordered joint list.
+ *
+ * Lets a sender and a controller agree on the joint order of a message that carries no joint names. Names are
+ * separated by a zero byte, so {"ab", "c"} and {"a", "bc"} hash differently.
+ */
+inline std::uint32_t joint_order_hash(const std::vector<std::string> &joint_names)
+{
+  std::uint32_t hash = 2166136261u;
+  for (const auto &name : joint_names)
+  {
+    for (unsigned char c : name)
+    {
+      hash = (hash ^ c) * 16777619u;
+    }
+    hash = (hash ^ 0u) * 16777619u;
+  }
+  return hash;
+}
+
+} // namespace control_utils
+
+#endif
@@ -1,14 +1,12 @@
 #ifndef ROS2_CONTROL_UTILS__PID_HPP
 #define ROS2_CONTROL_UTILS__PID_HPP
 
-//-- Extra --
-#include <deque>
-//-- End Extra --
-
+#include <array>
 #include <string>
 #include <cmath>
 #include <chrono>
 #include <rclcpp/rclcpp.hpp>
+#include <ros2_control_utils/realtime_buffer.hpp>
 
 
 namespace control_utils
@@ -26,17 +24,19 @@ public:
           d_gain_(d),
           i_max_(i_max),
           i_min_(i_min),
-          antiwindup_(false)
+          antiwindup_(false),
+          d_cutoff_(0.0)
     {
     }
     // Optional constructor for passing in values
-    Gains(double p, double i, double d, double i_max, double i_min, bool antiwindup)
+    Gains(double p, double i, double d, double i_max, double i_min, bool antiwindup, double d_cutoff = 0.0)
         : p_gain_(p),
           i_gain_(i),
           d_gain_(d),
           i_max_(i_max),
           i_min_(i_min),
-          antiwindup_(antiwindup)
+          antiwindup_(antiwindup),
+          d_cutoff_(d_cutoff)
     {
     }
     // Default constructor
@@ -46,7 +46,8 @@ public:
           d_gain_(0.0),
           i_max_(0.0),
           i_min_(0.0),
-          antiwindup_(false)
+          antiwindup_(false),
+          d_cutoff_(0.0)
     {
     }
     double p_gain_;   /**< Proportional gain. */
@@ -55,8 +56,12 @@ public:
     double i_max_;    /**< Maximum allowable integral term. */
     double i_min_;    /**< Minimum allowable integral term. */
     bool antiwindup_; /**< Antiwindup. */
+    double d_cutoff_; /**< Cutoff frequency [Hz] of the derivative low-pass filter, 0 for a moving average. */
   }; //end struct Gains
 
+  /* Number of samples in the derivative moving average, used when Gains::d_cutoff_ is 0. */
+  static constexpr std::size_t DERIVATIVE_WINDOW = 6;
+
   /**
  * @brief Constructor, zeros out Pid values when created and
  *        initialize Pid-gains and integral term limits.
@@ -68,28 +73,46 @@ public:
  * @param i_max The max integral windup.
  * @param i_min The min integral windup.
  * @param antiwindup Is anti windup enabled
+ * @param d_cutoff Cutoff frequency of the derivative filter, 0 for a moving average.
  */
-  Pid(double p = 0.0, double i = 0.0, double d = 0.0, double i_max = 0.0, double i_min = -0.0, bool antiwindup = false);
+  Pid(double p = 0.0, double i = 0.0, double d = 0.0, double i_max = 0.0, double i_min = -0.0, bool antiwindup = false,
+      double d_cutoff = 0.0);
   Pid(const Gains &gains);
 
+  /**
+   * @brief Gains are handed to the control thread through a lock-free buffer, so they can be changed while 
+   *        compute_command() is running in another thread. set_gains() and get_gains() must be called from a single
+   *        (non-realtime) thread.
+   */
   Gains get_gains();
   void set_gains(const Gains &gains);
 
-  double compute_command(double eaverageDeck_rror, rclcpp::Duration dt);
+  /**
+   * @brief Computes the command with the derivative estimated from consecutive errors.
+   * 
+   * The derivative is smoothed by a first order low-pass filter if Gains::d_cutoff_ is positive, else by a moving
+   * average over the last DERIVATIVE_WINDOW samples. Never allocates.
+   */
+  double compute_command(double error, rclcpp::Duration dt);
   double compute_command(double error, double error_dot, rclcpp::Duration dt);
   double get_current_cmd();
 
 private:
-  double p_error_last_; /**< _Save position state for derivative state calculation. */
-  double p_error_;      /**< Position error. */
-  double i_error_;      /**< Integral of position error. */
-  double d_error_;      /**< Derivative of position error. */
-  double cmd_;          /**< Command to send. */
-  std::shared_ptr<Gains> gains_buffer_;
+  double compute_command(double error, double error_dot, rclcpp::Duration dt, const Gains &gains);
+
+  double p_error_last_ = 0.0; /**< _Save position state for derivative state calculation. */
+  double p_error_ = 0.0;      /**< Position error. */
+  double i_error_ = 0.0;      /**< Integral of position error. */
+  double d_error_ = 0.0;      /**< Derivative of position error. */
+  double cmd_ = 0.0;          /**< Command to send. */
+  Gains gains_;                /**< Last gains set, owned by the non-realtime side. */
+  RealtimeBuffer<Gains> gains_buffer_;
 
-  //-- Extra --
-  std::deque<double> averageDeck_;
-  //-- End Extra --
+  // Derivative filter state
+  std::array<double, DERIVATIVE_WINDOW> derivative_history_ = {};
+  std::size_t derivative_slot_ = 0;
+  std::size_t derivative_count_ = 0;
+  double d_error_filtered_ = 0.0;
 };                        //end class Pid
 } // namespace control_helpers
 
@@ -0,0 +1,110 @@
+#ifndef ROS2_CONTROL_UTILS__PID_BANK_HPP
+#define ROS2_CONTROL_UTILS__PID_BANK_HPP
+
+#include <array>
+#include <cstddef>
+#include <rclcpp/rclcpp.hpp>
+#include <ros2_control_utils/pid.hpp>
+#include <ros2_control_utils/realtime_buffer.hpp>
+
+
+namespace control_utils
+{
+
+/**
+ * @brief A bank of independent PID controllers, one per joint, computed together.
+ *
+ * Same control law as Pid::compute_command(error, dt), but all state is stored as structure-of-arrays in fixed-size
+ * storage, so a single call runs every joint through the same branch free loop which the compiler can vectorize.
+ * Nothing is allocated after construction.
+ *
+ * The loop is compiled twice, for exactly YUMI_ARM_JOINTS joints and for any size(). A bank of a YuMi arm runs the
+ * first, whose bounds are known at compile time so the compiler unrolls and vectorizes it fully, other sizes the
+ * second.
+ *
+ * As for Pid, gains are handed to compute_commands() through a lock-free buffer. The gain setters must be called from
+ * a single non-realtime thread, compute_commands() from a single realtime thread.
+ */
+class PidBank
+{
+public:
+  static constexpr std::size_t MAX_JOINTS = 10;
+  static constexpr std::size_t YUMI_ARM_JOINTS = 7;
+  static constexpr std::size_t DERIVATIVE_WINDOW = Pid::DERIVATIVE_WINDOW;
+
+  using JointArray = std::array<double, MAX_JOINTS>;
+
+  /**
+   * @brief Constructor, zeros out the state of all controllers and gives all of them the same gains.
+   *
+   * @param size number of joints in the bank, at most MAX_JOINTS.
+   * @param gains gains used for every joint.
+   */
+  explicit PidBank(std::size_t size = 0, const Pid::Gains &gains = Pid::Gains());
+
+  /* Changes the number of active joints and zeros out the state. size is capped at MAX_JOINTS. */
+  void resize(std::size_t size);
+  std::size_t size() const { return size_; }
+
+  Pid::Gains get_gains(std::size_t joint) const;
+  void set_gains(const Pid::Gains &gains);
+  void set_gains(std::size_t joint, const Pid::Gains &gains);
+
+  /* Zeros out integral, derivative and command state of all joints. Not to be called while compute_commands() runs. */
+  void reset();
+
+  /**
+   * @brief Computes the command of every joint in the bank.
+   *
+   * Joints with a NaN or infinite error get a zero command and keep their state, as does the whole bank if dt is
+   * not positive.
+   *
+   * @param errors error = target - state, in joint order. Only the first size() elements are used.
+   * @param commands the computed commands, in joint order.
+   * @param dt time since the last call.
+   */
+  void compute_commands(const JointArray &errors, JointArray &commands, rclcpp::Duration dt);
+
+  /* Command computed for joint on the last call to compute_commands(). */
+  double get_current_cmd(std::size_t joint) const { return cmd_[joint]; }
+
+private:
+  std::size_t size_ = 0;
+
+  // Gains, with the anti windup bounds precomputed as limits on the integrated error
+  struct BankGains
+  {
+    alignas(64) JointArray p_gain_;
+    alignas(64) JointArray i_gain_;
+    alignas(64) JointArray d_gain_;
+    alignas(64) JointArray i_max_;
+    alignas(64) JointArray i_min_;
+    alignas(64) JointArray d_cutoff_;
+    alignas(64) JointArray i_error_lower_;  /**< Lower bound on i_error_, -inf when not limited. */
+    alignas(64) JointArray i_error_upper_;  /**< Upper bound on i_error_, inf when not limited. */
+    alignas(64) JointArray integrate_;      /**< 1 if the integral term is in use, else 0. */
+    alignas(64) JointArray d_rc_;           /**< Time constant of the derivative low-pass filter, 0 if unused. */
+    std::array<bool, MAX_JOINTS> antiwindup_;
+  };
+  BankGains gains_;                         /**< Last gains set, owned by the non-realtime side. */
+  RealtimeBuffer<BankGains> gains_buffer_;
+
+  void store_gains(std::size_t joint, const Pid::Gains &gains);
+
+  /* The control law of compute_commands() for the first N joints, or size() joints if N is 0. */
+  template <std::size_t N>
+  void compute_joints(const BankGains &gains, const JointArray &errors, JointArray &commands, double dt_s);
+
+  // State
+  alignas(64) JointArray p_error_last_;
+  alignas(64) JointArray i_error_;
+  alignas(64) JointArray cmd_;
+  alignas(64) JointArray d_error_filtered_;
+  alignas(64) std::array<JointArray, DERIVATIVE_WINDOW> derivative_history_;
+  std::size_t derivative_slot_ = 0;
+  std::size_t derivative_count_ = 0;
+}; // end class PidBank
+
+} // namespace control_utils
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef ROS2_CONTROL_UTILS__PID_TUNER_HPP
+#define ROS2_CONTROL_UTILS__PID_TUNER_HPP
+
+#include <vector>
+#include <ros2_control_utils/pid.hpp>
+
+
+namespace control_utils
+{
+
+/**
+ * @brief Integrating plant with dead time, dy/dt = gain * u(t - dead_time).
+ *
+ * This is how a joint looks from the JointPositionController: its command is added to the current position every
+ * cycle, so the joint integrates the pid output, delayed by the hardware and the robot controller.
+ */
+struct IntegratingPlant
+{
+  double gain = 0.0;       /**< [1/s] Joint velocity per unit of pid output. */
+  double dead_time = 0.0;  /**< [s] Delay from pid output to joint motion. */
+  double residual = 0.0;   /**< Mean squared error of the fit, [rad^2/s^2]. */
+};
+
+/**
+ * @brief Identifies an integrating plant from a closed loop step response under P control.
+ *
+ * With the controller running P only with gain probe_p, the error follows de/dt = -gain * probe_p * e(t - dead_time).
+ * Every dead time on a grid up to max_dead_time is tried and the gain is fit by least squares, the dead time with
+ * the smallest residual is kept.
+ *
+ * @param time sample times [s], relative to the step, strictly increasing. The error is taken as 0 before time 0.
+ * @param error error = target - position at each sample.
+ * @param probe_p p gain the controller ran with during the experiment.
+ * @param max_dead_time largest dead time tried [s].
+ * @param dead_time_step resolution of the dead time grid [s], typically the control cycle time.
+ * @return the identified plant, gain is 0 if the data does not allow a fit.
+ */
+IntegratingPlant identify_integrating_plant(const std::vector<double> &time, const std::vector<double> &error,
+                                            double probe_p, double max_dead_time, double dead_time_step);
+
+/**
+ * @brief SIMC tuning of a PI controller for an integrating plant.
+ *
+ * The closed loop time constant is chosen from the settling time target (about 4 time constants plus the dead time),
+ * but never below the dead time, which keeps a gain margin of about 3.
+ *
+ * @param plant the identified plant.
+ * @param settling_time desired 2% settling time [s].
+ * @param use_integral false for a P controller, which has no steady state error on an integrating plant.
+ * @param base gains whose limits (i_min, i_max, antiwindup, d_cutoff) are kept.
+ */
+Pid::Gains simc_gains(const IntegratingPlant &plant, double settling_time, bool use_integral,
+                      const Pid::Gains &base = Pid::Gains());
+
+/**
+ * @brief Simulates a step on the identified plant with control_utils::Pid and returns the 2% settling time.
+ *
+ * @param plant the identified plant.
+ * @param gains gains to evaluate.
+ * @param cycle_time control cycle time [s].
+ * @param horizon simulated time [s].
+ * @return the settling time [s], or a negative value if the response has not settled within the horizon.
+ */
+double predict_settling_time(const IntegratingPlant &plant, const Pid::Gains &gains, double cycle_time,
+                             double horizon);
+
+} // namespace control_utils
+
+#endif
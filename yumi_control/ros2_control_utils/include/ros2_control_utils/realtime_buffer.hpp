@@ -0,0 +1,97 @@
+#ifndef ROS2_CONTROL_UTILS__REALTIME_BUFFER_HPP
+#define ROS2_CONTROL_UTILS__REALTIME_BUFFER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+
+namespace control_utils
+{
+
+/**
+ * @brief Lock-free handover of a value from one non-realtime writer to one realtime reader.
+ *
+ * Triple buffer: the writer fills its private back slot and atomically swaps it with the shared middle slot, the
+ * reader swaps the middle slot with its private front slot whenever the writer has published something new. Neither
+ * side ever blocks or allocates, and the reader always sees a complete value.
+ *
+ * Only one thread may write and only one thread may read at a time. T should be cheap to copy, e.g. a fixed-size
+ * array, as write_from_non_rt() copies the value into the back slot.
+ *
+ * The handover is symmetric, so the same buffer also carries state from the realtime thread to a non-realtime
+ * reader through write_from_rt() and read_from_non_rt(). Copying does not allocate if T only holds vectors that
+ * were sized by initialize().
+ */
+template <class T>
+class RealtimeBuffer
+{
+public:
+  RealtimeBuffer()
+      : RealtimeBuffer(T())
+  {
+  }
+
+  explicit RealtimeBuffer(const T &initial_value)
+      : buffers_{{initial_value, initial_value, initial_value}}
+  {
+  }
+
+  RealtimeBuffer(const RealtimeBuffer &) = delete;
+  RealtimeBuffer &operator=(const RealtimeBuffer &) = delete;
+
+  /**
+   * @brief Resets all slots to the given value.
+   *
+   * Not thread safe, only to be used while neither the reader nor the writer is running, e.g. during activation.
+   */
+  void initialize(const T &value)
+  {
+    buffers_.fill(value);
+    front_ = 0;
+    back_ = 2;
+    middle_.store(1, std::memory_order_release);
+  }
+
+  /* Publishes a new value to the realtime side. Never blocks. */
+  void write_from_non_rt(const T &value)
+  {
+    buffers_[back_] = value;
+    back_ = middle_.exchange(back_ | NEW_DATA, std::memory_order_acq_rel) & INDEX_MASK;
+  }
+
+  /* Returns the most recently published value. Never blocks, the reference stays valid until the next call. */
+  const T &read_from_rt()
+  {
+    if (middle_.load(std::memory_order_relaxed) & NEW_DATA)
+    {
+      front_ = middle_.exchange(front_, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+    return buffers_[front_];
+  }
+
+  /* Publishes a new value from the realtime side. Never blocks. */
+  void write_from_rt(const T &value)
+  {
+    write_from_non_rt(value);
+  }
+
+  /* Returns the most recently published value to the non-realtime side. */
+  const T &read_from_non_rt()
+  {
+    return read_from_rt();
+  }
+
+private:
+  static constexpr std::uint8_t INDEX_MASK = 0x3;
+  static constexpr std::uint8_t NEW_DATA = 0x4;
+
+  std::array<T, 3> buffers_;
+  std::atomic<std::uint8_t> middle_{1};
+  std::uint8_t front_ = 0; /**< Owned by the reader. */
+  std::uint8_t back_ = 2;  /**< Owned by the writer. */
+}; // end class RealtimeBuffer
+
+} // namespace control_utils
+
+#endif
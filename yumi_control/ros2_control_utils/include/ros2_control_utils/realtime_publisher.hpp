@@ -0,0 +1,126 @@
+#ifndef ROS2_CONTROL_UTILS__REALTIME_PUBLISHER_HPP
+#define ROS2_CONTROL_UTILS__REALTIME_PUBLISHER_HPP
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include <rclcpp/publisher.hpp>
+
+
+namespace control_utils
+{
+
+/**
+ * @brief Publishes messages filled in the realtime thread from a thread of its own.
+ *
+ * The realtime side try_lock()s the publisher, fills msg_ and hands it over with unlock_and_publish(). If the
+ * previous message is still being published try_lock() fails at once and the cycle goes without publishing, so the
+ * control loop never waits on the middleware. Messages are loaned from the middleware where it supports that, e.g.
+ * for fixed size messages with a shared memory transport, and are copied otherwise.
+ *
+ * Copying into the outgoing message does not allocate once it has the size of msg_.
+ */
+template <class MessageT>
+class RealtimePublisher
+{
+public:
+  explicit RealtimePublisher(std::shared_ptr<rclcpp::Publisher<MessageT>> publisher)
+      : publisher_(std::move(publisher)), thread_(&RealtimePublisher::run, this)
+  {
+  }
+
+  RealtimePublisher(const RealtimePublisher &) = delete;
+  RealtimePublisher &operator=(const RealtimePublisher &) = delete;
+
+  ~RealtimePublisher()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_ = false;
+    }
+    condition_.notify_one();
+    thread_.join();
+  }
+
+  /**
+   * @brief Locks msg_ for the realtime side. Never blocks.
+   *
+   * Returns false if the previous message has not been published yet, or msg_ is locked otherwise.
+   */
+  bool try_lock()
+  {
+    if (!mutex_.try_lock())
+    {
+      return false;
+    }
+    if (pending_)
+    {
+      mutex_.unlock();
+      return false;
+    }
+    return true;
+  }
+
+  /* Hands the filled msg_ over to the publishing thread and unlocks it. */
+  void unlock_and_publish()
+  {
+    pending_ = true;
+    mutex_.unlock();
+    condition_.notify_one();
+  }
+
+  /* Unlocks msg_ without publishing it. */
+  void unlock()
+  {
+    mutex_.unlock();
+  }
+
+  MessageT msg_; /**< Only to be accessed between a successful try_lock() and the following unlock. */
+
+private:
+  void run()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+      condition_.wait(lock, [this] { return pending_ || !running_; });
+      if (!running_)
+      {
+        return;
+      }
+
+      // Copy out under the lock, publish without it so the realtime side is only held off for the copy
+      if (publisher_->can_loan_messages())
+      {
+        auto loaned = publisher_->borrow_loaned_message();
+        loaned.get() = msg_;
+        pending_ = false;
+        lock.unlock();
+        publisher_->publish(std::move(loaned));
+      }
+      else
+      {
+        outgoing_ = msg_;
+        pending_ = false;
+        lock.unlock();
+        publisher_->publish(outgoing_);
+      }
+      lock.lock();
+    }
+  }
+
+  std::shared_ptr<rclcpp::Publisher<MessageT>> publisher_;
+  MessageT outgoing_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool pending_ = false; /**< msg_ is waiting to be published, guarded by mutex_. */
+  bool running_ = true;  /**< Guarded by mutex_. */
+  std::thread thread_;   /**< Last, so it starts once everything else is constructed. */
+}; // end class RealtimePublisher
+
+} // namespace control_utils
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef ROS2_CONTROL_UTILS__REALTIME_QUEUE_HPP
+#define ROS2_CONTROL_UTILS__REALTIME_QUEUE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+
+namespace control_utils
+{
+
+/**
+ * @brief Lock-free bounded FIFO from one non-realtime producer to one realtime consumer.
+ *
+ * Ring buffer of N slots with atomic head and tail indices, N a power of two. Unlike RealtimeBuffer every pushed value
+ * is delivered, in order, until the queue is full: a full queue rejects new values instead of overwriting old ones.
+ * Neither side ever blocks or allocates.
+ *
+ * Only one thread may push and only one thread may pop or peek at a time.
+ */
+template <class T, std::size_t N>
+class RealtimeQueue
+{
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "RealtimeQueue size must be a power of two");
+
+public:
+  RealtimeQueue() = default;
+  RealtimeQueue(const RealtimeQueue &) = delete;
+  RealtimeQueue &operator=(const RealtimeQueue &) = delete;
+
+  /* Appends a value. Returns false, and drops the value, if the queue is full. */
+  bool push(const T &value)
+  {
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) >= N)
+    {
+      return false;
+    }
+    slots_[tail & (N - 1)] = value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /* Removes the oldest value into value. Returns false if the queue is empty. */
+  bool pop(T &value)
+  {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+    value = slots_[head & (N - 1)];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /* The oldest value, or nullptr if the queue is empty. Valid until the next pop(). */
+  const T *front() const
+  {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire))
+    {
+      return nullptr;
+    }
+    return &slots_[head & (N - 1)];
+  }
+
+  /* Number of queued values, a lower bound on the consumer side and an upper bound on the producer side. */
+  std::size_t size() const
+  {
+    return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+  }
+
+  static constexpr std::size_t capacity()
+  {
+    return N;
+  }
+
+private:
+  std::array<T, N> slots_{};
+  alignas(64) std::atomic<std::size_t> head_{0}; /**< Written by the consumer. */
+  alignas(64) std::atomic<std::size_t> tail_{0}; /**< Written by the producer. */
+}; // end class RealtimeQueue
+
+} // namespace control_utils
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef ROS2_CONTROL_UTILS__TRACKING_STATISTICS_HPP
+#define ROS2_CONTROL_UTILS__TRACKING_STATISTICS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace control_utils
+{
+
+/* Tracking error of every joint over one segment of motion, as computed by TrackingStatistics. */
+struct TrackingSummary
+{
+  static constexpr std::size_t MAX_JOINTS = 10;
+  using JointArray = std::array<double, MAX_JOINTS>;
+
+  std::size_t size = 0;          /**< Number of joints. */
+  uint64_t segment = 0;          /**< Counts the segments started, identifies the segment summarized. */
+  int64_t start_ns = 0;          /**< Time of the start of the segment. */
+  int64_t last_sample_ns = 0;    /**< Time of the last sample. */
+  int64_t goal_ns = -1;          /**< Time the reference reached its goal, -1 if it has not yet. */
+  std::size_t samples = 0;
+  JointArray rms_error = {};     /**< Root mean square of the error over the segment. */
+  JointArray max_error = {};     /**< Largest absolute error over the segment. */
+  JointArray goal_error = {};    /**< Error when the reference reached its goal. */
+  JointArray settling_time = {}; /**< [s] from the goal until the error stayed within tolerance, -1 if not settled. */
+};
+
+/**
+ * @brief Online per joint tracking error statistics of a controller, over segments of motion.
+ *
+ * A segment starts with a new reference, e.g. a trajectory, and lasts until the next one. While the reference moves
+ * towards its goal the error is tracked, once it is there the joints settle. RMS and max error cover the whole
+ * segment. Error is desired - actual.
+ *
+ * Nothing is allocated, so all members can be called from the control loop.
+ */
+class TrackingStatistics
+{
+public:
+  static constexpr std::size_t MAX_JOINTS = TrackingSummary::MAX_JOINTS;
+  using JointArray = TrackingSummary::JointArray;
+
+  /**
+   * @param size number of joints, at most MAX_JOINTS.
+   * @param settling_tolerance [rad] error a joint is settled within.
+   */
+  explicit TrackingStatistics(std::size_t size = 0, double settling_tolerance = 0.01);
+
+  /* Changes the number of joints, capped at MAX_JOINTS, and clears the statistics. */
+  void resize(std::size_t size);
+  void set_settling_tolerance(double settling_tolerance) { settling_tolerance_ = settling_tolerance; }
+
+  /* Ends the current segment and starts a new one at start_ns. */
+  void start(int64_t start_ns);
+
+  /**
+   * @brief Adds the errors of every joint at time_ns to the current segment.
+   *
+   * @param errors desired - actual, in joint order. Only the first size() elements are used.
+   * @param at_goal true once the reference has reached its goal. The first such sample gives the goal error.
+   */
+  void add_sample(int64_t time_ns, const JointArray &errors, bool at_goal);
+
+  /* Statistics of the current segment, up to the last sample. */
+  const TrackingSummary &summary() const { return summary_; }
+  std::size_t size() const { return summary_.size; }
+
+private:
+  TrackingSummary summary_;
+  double settling_tolerance_;
+  JointArray squared_error_sum_ = {};
+  std::array<int64_t, MAX_JOINTS> last_unsettled_ns_ = {};  /**< Last sample at or after the goal out of tolerance. */
+}; // end class TrackingStatistics
+
+} // namespace control_utils
+
+#endif
@@ -5,26 +5,29 @@ namespace control_utils
 {
 using namespace std::chrono_literals;
 
-Pid::Pid(double p, double i, double d, double i_max, double i_min, bool antiwindup)
+Pid::Pid(double p, double i, double d, double i_max, double i_min, bool antiwindup, double d_cutoff)
+    : gains_(p, i, d, i_max, i_min, antiwindup, d_cutoff),
+      gains_buffer_(gains_)
 {
-  gains_buffer_ = std::make_shared<Gains>(p, i, d, i_max, i_min, antiwindup);
 }
 
 
 Pid::Pid(const Gains &gains)
+    : gains_(gains),
+      gains_buffer_(gains)
 {
-  gains_buffer_ = std::make_shared<Gains>(gains);
 }
 
 
 Pid::Gains Pid::get_gains()
 {
-  return *gains_buffer_;
+  return gains_;
 }
 
 void Pid::set_gains(const Pid::Gains &gains)
 {
-  gains_buffer_ = std::make_shared<Pid::Gains>(gains);
+  gains_ = gains;
+  gains_buffer_.write_from_non_rt(gains_);
 }
 
 double Pid::compute_command(double error, rclcpp::Duration dt)
@@ -44,28 +47,47 @@ double Pid::compute_command(double error, rclcpp::Duration dt)
     p_error_last_ = error;
   }
 
-  //-- Extra --
-  averageDeck_.push_back(error_dot);
-  if(averageDeck_.size() > 6)
+  // Read once, so a gain update cannot land between the filter and the command
+  const Gains &gains = gains_buffer_.read_from_rt();
+  const double d_cutoff = gains.d_cutoff_;
+  if (d_cutoff > 0.0)
   {
-    averageDeck_.pop_front();
+    // First order low-pass filter, alpha = dt / (dt + RC)
+    double alpha = 1.0;
+    if (dt > 0.0s)
+    {
+      alpha = dt.seconds() / (dt.seconds() + 1.0 / (2.0 * M_PI * d_cutoff));
+    }
+    d_error_filtered_ += alpha * (error_dot - d_error_filtered_);
+    error_dot = d_error_filtered_;
   }
-  double sum = 0;
-  for(auto &val : averageDeck_)
+  else
   {
-    sum+=val;
+    // Moving average over the samples seen so far, at most DERIVATIVE_WINDOW
+    derivative_history_[derivative_slot_] = error_dot;
+    derivative_slot_ = (derivative_slot_ + 1) % DERIVATIVE_WINDOW;
+    derivative_count_ = std::min(derivative_count_ + 1, DERIVATIVE_WINDOW);
+
+    double sum = 0.0;
+    for (auto &val : derivative_history_)
+    {
+      sum += val;
+    }
+    error_dot = sum / derivative_count_;
+    d_error_filtered_ = error_dot;
   }
-  error_dot = sum/6;
-  //-- Extra end --
 
-  return compute_command(error, error_dot, dt);
+  return compute_command(error, error_dot, dt, gains);
 }
 
 double Pid::compute_command(double error, double error_dot, rclcpp::Duration dt)
 {
   // Get the gain parameters from the realtime buffer
-  Gains gains = *gains_buffer_;
+  return compute_command(error, error_dot, dt, gains_buffer_.read_from_rt());
+}
 
+double Pid::compute_command(double error, double error_dot, rclcpp::Duration dt, const Gains &gains)
+{
   double p_term{0.0}, d_term{0.0}, i_term{0.0};
   p_error_ = error; // this is error = target - state
   d_error_ = error_dot;
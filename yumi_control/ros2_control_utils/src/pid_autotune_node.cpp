@@ -0,0 +1,340 @@
+// Step response tuning of the joint_position_controller gains.
+//
+// For each joint the controller is switched to a P controller with gain probe_p, the joint is stepped by step radians
+// and its response recorded from <namespace>/joint_states. An integrating plant with dead time is fit to every
+// response, and SIMC gains for the settling_time target are computed, keeping the most conservative over the joints.
+// The controller keeps the new gains, and they are written to params_file if one is given.
+//
+// Usage: ros2 run ros2_control_utils pid_autotune_node --ros-args -p namespace:=/r -p params_file:=<yumi_params_R.yaml>
+
+#include <rclcpp/rclcpp.hpp>
+#include <sensor_msgs/msg/joint_state.hpp>
+#include <ros2_control_interfaces/msg/joint_control.hpp>
+#include <ros2_control_interfaces/msg/pid_parameters.hpp>
+#include <ros2_control_utils/pid_tuner.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <future>
+#include <sstream>
+#include <mutex>
+#include <unordered_map>
+
+using namespace std::chrono_literals;
+
+// Subscribes to the joint states and records the response of one joint at a time
+class PidAutotuneNode : public rclcpp::Node
+{
+public:
+  PidAutotuneNode() : rclcpp::Node("pid_autotune")
+  {
+  }
+
+  void subscribe(const std::string &ns)
+  {
+    joint_state_subscription_ = create_subscription<sensor_msgs::msg::JointState>(
+      ns + "/joint_states", 10, std::bind(&PidAutotuneNode::callback_joint_states, this, std::placeholders::_1));
+  }
+
+  std::vector<std::string> latest_names()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return latest_names_;
+  }
+
+  double latest_position(const std::string &joint)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return latest_positions_[joint];
+  }
+
+  // Starts recording joint. The time is counted from the stamp of the first joint state received after the call, so
+  // start recording right before the step is published.
+  void start_recording(const std::string &joint)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    joint_ = joint;
+    time_.clear();
+    position_.clear();
+    start_ = rclcpp::Time();
+    started_ = false;
+    active_ = true;
+  }
+
+  // Stops recording and returns the samples as time since the start and position
+  void stop_recording(std::vector<double> &time, std::vector<double> &position)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    active_ = false;
+    time = time_;
+    position = position_;
+  }
+
+private:
+  void callback_joint_states(sensor_msgs::msg::JointState::UniquePtr msg)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    latest_names_ = msg->name;
+    for (size_t i = 0; i < msg->name.size() && i < msg->position.size(); i++)
+    {
+      latest_positions_[msg->name[i]] = msg->position[i];
+    }
+
+    if (active_ && latest_positions_.count(joint_))
+    {
+      // The joint states are stamped by the hardware clock, so the start is taken from them as well
+      rclcpp::Time stamp(msg->header.stamp);
+      if (!started_)
+      {
+        start_ = stamp;
+        started_ = true;
+      }
+      time_.push_back((stamp - start_).seconds());
+      position_.push_back(latest_positions_[joint_]);
+    }
+  }
+
+  rclcpp::Subscription<sensor_msgs::msg::JointState>::SharedPtr joint_state_subscription_;
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, double> latest_positions_;
+  std::vector<std::string> latest_names_;
+  bool active_ = false;
+  bool started_ = false;
+  std::string joint_;
+  std::vector<double> time_;
+  std::vector<double> position_;
+  rclcpp::Time start_;
+};
+
+
+void spin(std::shared_ptr<rclcpp::executors::MultiThreadedExecutor> exe)
+{
+  exe->spin();
+}
+
+
+// Rewrites the line of the pid entry of the controller with every field of gains. The rest of the file, comments and
+// layout included, is copied unchanged. Expects the entry in flow style on one line, as in the yumi_params files.
+bool write_gains(const std::string &params_file, const std::string &controller, const control_utils::Pid::Gains &gains)
+{
+  std::ifstream in(params_file);
+  if (!in)
+  {
+    return false;
+  }
+  std::stringstream content;
+  content << in.rdbuf();
+  in.close();
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(content, line);)
+  {
+    lines.push_back(line);
+  }
+  // getline drops a last empty line, so a final newline is only written back if there was one
+  bool final_newline = !content.str().empty() && content.str().back() == '\n';
+
+  auto indentation = [](const std::string &line) { return line.find_first_not_of(' '); };
+  std::ostringstream entry;
+  entry << "pid: {p: " << gains.p_gain_ << ", i: " << gains.i_gain_ << ", d: " << gains.d_gain_
+        << ", i_min: " << gains.i_min_ << ", i_max: " << gains.i_max_
+        << ", antiwindup: " << (gains.antiwindup_ ? "True" : "False") << ", d_cutoff: " << gains.d_cutoff_ << "}";
+
+  bool found = false;
+  for (size_t i = 0; i < lines.size(); i++)
+  {
+    size_t indent = indentation(lines[i]);
+    if (indent == std::string::npos || lines[i].compare(indent, controller.size() + 1, controller + ":") != 0)
+    {
+      continue;
+    }
+    // The pid key of this block, before the next key at the indentation of the controller or less
+    for (size_t j = i + 1; j < lines.size(); j++)
+    {
+      size_t key_indent = indentation(lines[j]);
+      if (key_indent == std::string::npos || lines[j][key_indent] == '#')
+      {
+        continue;
+      }
+      if (key_indent <= indent)
+      {
+        break;
+      }
+      if (lines[j].compare(key_indent, 4, "pid:") == 0)
+      {
+        // Keep a trailing comment
+        size_t end = lines[j].find('}', key_indent);
+        std::string rest = end == std::string::npos ? "" : lines[j].substr(end + 1);
+        lines[j] = lines[j].substr(0, key_indent) + entry.str() + rest;
+        found = true;
+        break;
+      }
+    }
+  }
+  if (!found)
+  {
+    return false;
+  }
+
+  std::ofstream out(params_file);
+  for (size_t i = 0; i < lines.size(); i++)
+  {
+    out << lines[i] << (i + 1 < lines.size() || final_newline ? "\n" : "");
+  }
+  return out.good();
+}
+
+
+int main(int argc, char *argv[])
+{
+  rclcpp::init(argc, argv);
+  auto node = std::make_shared<PidAutotuneNode>();
+  auto logger = node->get_logger();
+
+  auto ns = node->declare_parameter("namespace", std::string("/r"));
+  auto controller = node->declare_parameter("controller", std::string("joint_position_controller"));
+  auto joints = node->declare_parameter("joints", std::vector<std::string>{});
+  auto params_file = node->declare_parameter("params_file", std::string(""));
+  double step = node->declare_parameter("step", 0.05);
+  double probe_p = node->declare_parameter("probe_p", 0.05);
+  double settling_time = node->declare_parameter("settling_time", 0.3);
+  bool use_integral = node->declare_parameter("use_integral", false);
+  double cycle_time = node->declare_parameter("cycle_time", 0.004);
+  double record_time = node->declare_parameter("record_time", 1.5);
+  double max_dead_time = node->declare_parameter("max_dead_time", 0.1);
+  double i_max = node->declare_parameter("i_max", 4.0);
+  double d_cutoff = node->declare_parameter("d_cutoff", 0.0);
+
+  auto gains_publisher = node->create_publisher<ros2_control_interfaces::msg::PidParameters>(
+    ns + "/pid_parameters", 10);
+  auto command_publisher = node->create_publisher<ros2_control_interfaces::msg::JointControl>(
+    ns + "/joint_commands", rclcpp::SensorDataQoS());
+  node->subscribe(ns);
+
+  auto executor = std::make_shared<rclcpp::executors::MultiThreadedExecutor>();
+  executor->add_node(node);
+  auto future_handle = std::async(std::launch::async, spin, executor);
+
+  auto publish_gains = [&](const control_utils::Pid::Gains &gains) {
+    ros2_control_interfaces::msg::PidParameters msg;
+    msg.controller = controller;
+    msg.p = gains.p_gain_;
+    msg.i = gains.i_gain_;
+    msg.d = gains.d_gain_;
+    msg.i_min = gains.i_min_;
+    msg.i_max = gains.i_max_;
+    msg.antiwindup = gains.antiwindup_;
+    msg.d_cutoff = gains.d_cutoff_;
+    gains_publisher->publish(msg);
+  };
+  auto publish_goal = [&](const std::string &joint, double goal) {
+    ros2_control_interfaces::msg::JointControl msg;
+    msg.header.stamp = node->now();
+    msg.joints = {joint};
+    msg.goals = {goal};
+    command_publisher->publish(msg);
+  };
+
+  // Wait for the joint states to know the joints and where they are
+  while (rclcpp::ok())
+  {
+    if (!node->latest_names().empty())
+    {
+      break;
+    }
+    RCLCPP_INFO_ONCE(logger, "Waiting for %s/joint_states", ns.c_str());
+    rclcpp::sleep_for(100ms);
+  }
+  if (joints.empty())
+  {
+    joints = node->latest_names();
+  }
+
+  const control_utils::Pid::Gains base(0.0, 0.0, 0.0, i_max, -i_max, true, d_cutoff);
+  control_utils::Pid::Gains probe = base;
+  probe.p_gain_ = probe_p;
+  publish_gains(probe);
+  rclcpp::sleep_for(200ms);
+
+  std::vector<control_utils::IntegratingPlant> plants;
+  for (const auto &joint : joints)
+  {
+    if (!rclcpp::ok())
+    {
+      break;
+    }
+
+    double initial = node->latest_position(joint);
+    node->start_recording(joint);
+    publish_goal(joint, initial + step);
+    rclcpp::sleep_for(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(record_time)));
+
+    std::vector<double> recorded_time, recorded_position;
+    node->stop_recording(recorded_time, recorded_position);
+    std::vector<double> time = {0.0}, error = {step};
+    for (size_t i = 0; i < recorded_time.size(); i++)
+    {
+      if (recorded_time[i] > 0.0)
+      {
+        time.push_back(recorded_time[i]);
+        error.push_back(initial + step - recorded_position[i]);
+      }
+    }
+
+    // Back to where the joint started
+    publish_goal(joint, initial);
+    rclcpp::sleep_for(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(record_time)));
+
+    auto plant = control_utils::identify_integrating_plant(time, error, probe_p, max_dead_time, cycle_time);
+    if (plant.gain <= 0)
+    {
+      RCLCPP_WARN(logger, "%s: no usable response in %zu samples, skipping joint", joint.c_str(), time.size());
+      continue;
+    }
+    RCLCPP_INFO(logger, "%s: gain %.2f 1/s, dead time %.3f s, residual %g", joint.c_str(), plant.gain,
+      plant.dead_time, plant.residual);
+    plants.push_back(plant);
+  }
+
+  if (plants.empty())
+  {
+    RCLCPP_ERROR(logger, "No joint could be identified, the controller keeps the probe gains");
+    rclcpp::shutdown();
+    return -1;
+  }
+
+  // The controller shares one set of gains between its joints, so the most conservative gains are used
+  auto gains = control_utils::simc_gains(plants.front(), settling_time, use_integral, base);
+  for (const auto &plant : plants)
+  {
+    auto joint_gains = control_utils::simc_gains(plant, settling_time, use_integral, base);
+    gains.p_gain_ = std::min(gains.p_gain_, joint_gains.p_gain_);
+    gains.i_gain_ = std::min(gains.i_gain_, joint_gains.i_gain_);
+  }
+
+  double predicted = 0.0;
+  for (const auto &plant : plants)
+  {
+    double settled = control_utils::predict_settling_time(plant, gains, cycle_time, 10 * settling_time);
+    predicted = (settled < 0 || predicted < 0) ? -1.0 : std::max(predicted, settled);
+  }
+  RCLCPP_INFO(logger, "Tuned gains: p %f, i %f, d %f. Predicted settling time %.3f s (target %.3f s)",
+    gains.p_gain_, gains.i_gain_, gains.d_gain_, predicted, settling_time);
+  publish_gains(gains);
+
+  if (!params_file.empty())
+  {
+    if (write_gains(params_file, controller, gains))
+    {
+      RCLCPP_INFO(logger, "Gains written to %s", params_file.c_str());
+    }
+    else
+    {
+      RCLCPP_ERROR(logger, "Could not write the %s pid entry of %s", controller.c_str(), params_file.c_str());
+    }
+  }
+
+  rclcpp::sleep_for(200ms);
+  rclcpp::shutdown();
+  return 0;
+}
@@ -0,0 +1,156 @@
+#include <ros2_control_utils/pid_bank.hpp>
+#include <algorithm>
+#include <limits>
+
+namespace control_utils
+{
+
+PidBank::PidBank(std::size_t size, const Pid::Gains &gains)
+{
+  set_gains(gains);
+  resize(size);
+}
+
+
+void PidBank::resize(std::size_t size)
+{
+  size_ = std::min(size, MAX_JOINTS);
+  reset();
+}
+
+
+Pid::Gains PidBank::get_gains(std::size_t joint) const
+{
+  return Pid::Gains(gains_.p_gain_[joint], gains_.i_gain_[joint], gains_.d_gain_[joint], gains_.i_max_[joint], 
+                    gains_.i_min_[joint], gains_.antiwindup_[joint], gains_.d_cutoff_[joint]);
+}
+
+
+void PidBank::set_gains(const Pid::Gains &gains)
+{
+  for (std::size_t joint = 0; joint < MAX_JOINTS; ++joint)
+  {
+    store_gains(joint, gains);
+  }
+  gains_buffer_.write_from_non_rt(gains_);
+}
+
+
+void PidBank::set_gains(std::size_t joint, const Pid::Gains &gains)
+{
+  if (joint >= MAX_JOINTS)
+  {
+    return;
+  }
+  store_gains(joint, gains);
+  gains_buffer_.write_from_non_rt(gains_);
+}
+
+
+void PidBank::store_gains(std::size_t joint, const Pid::Gains &gains)
+{
+  gains_.p_gain_[joint] = gains.p_gain_;
+  gains_.i_gain_[joint] = gains.i_gain_;
+  gains_.d_gain_[joint] = gains.d_gain_;
+  gains_.i_max_[joint] = gains.i_max_;
+  gains_.i_min_[joint] = gains.i_min_;
+  gains_.d_cutoff_[joint] = gains.d_cutoff_;
+  gains_.antiwindup_[joint] = gains.antiwindup_;
+  gains_.integrate_[joint] = (gains.i_gain_ != 0) ? 1.0 : 0.0;
+  gains_.d_rc_[joint] = (gains.d_cutoff_ > 0) ? 1.0 / (2.0 * M_PI * gains.d_cutoff_) : 0.0;
+
+  // Prevent i_error_ from climbing higher than permitted by i_max_/i_min_
+  gains_.i_error_lower_[joint] = -std::numeric_limits<double>::infinity();
+  gains_.i_error_upper_[joint] = std::numeric_limits<double>::infinity();
+  if (gains.antiwindup_ && gains.i_gain_ != 0)
+  {
+    std::pair<double, double> bounds = std::minmax(gains.i_min_ / gains.i_gain_, gains.i_max_ / gains.i_gain_);
+    gains_.i_error_lower_[joint] = bounds.first;
+    gains_.i_error_upper_[joint] = bounds.second;
+  }
+}
+
+
+void PidBank::reset()
+{
+  p_error_last_.fill(0.0);
+  i_error_.fill(0.0);
+  cmd_.fill(0.0);
+  d_error_filtered_.fill(0.0);
+  for (auto &samples : derivative_history_)
+  {
+    samples.fill(0.0);
+  }
+  derivative_slot_ = 0;
+  derivative_count_ = 0;
+}
+
+
+template <std::size_t N>
+void PidBank::compute_joints(const BankGains &gains, const JointArray &errors, JointArray &commands, double dt_s)
+{
+  static_assert(N <= MAX_JOINTS, "a bank holds at most MAX_JOINTS joints");
+  const std::size_t joint_num = (N > 0) ? N : size_;
+  const double inv_dt = 1.0 / dt_s;
+  auto &derivative_slot = derivative_history_[derivative_slot_];
+  const double inv_count = 1.0 / derivative_count_;
+
+  // Every step is written as a select instead of a branch so that the loop vectorizes across joints.
+  for (std::size_t i = 0; i < joint_num; ++i)
+  {
+    const double error = errors[i];
+    const bool valid = (error - error) == 0.0; // false for NaN and inf
+
+    // Calculate the derivative error, smoothed by either a moving average or a first order low-pass filter
+    const double error_dot = (error - p_error_last_[i]) * inv_dt;
+    p_error_last_[i] = valid ? error : p_error_last_[i];
+    // An invalid cycle leaves 0 in its slot, a stale derivative would otherwise be averaged in once valid again
+    derivative_slot[i] = valid ? error_dot : 0.0;
+
+    double sum = 0.0;
+    for (std::size_t k = 0; k < DERIVATIVE_WINDOW; ++k)
+    {
+      sum += derivative_history_[k][i];
+    }
+    const double alpha = dt_s / (dt_s + gains.d_rc_[i]);
+    const double low_pass = d_error_filtered_[i] + alpha * (error_dot - d_error_filtered_[i]);
+    const double d_error = (gains.d_rc_[i] > 0.0) ? low_pass : sum * inv_count;
+    d_error_filtered_[i] = valid ? d_error : d_error_filtered_[i];
+
+    // Calculate the integral of the position error, clamped by the anti windup bounds
+    const double i_error = std::min(std::max(i_error_[i] + gains.integrate_[i] * dt_s * error, 
+                                             gains.i_error_lower_[i]),
+                                    gains.i_error_upper_[i]);
+    i_error_[i] = valid ? i_error : i_error_[i];
+
+    const double cmd = gains.p_gain_[i] * error + gains.i_gain_[i] * i_error_[i] + gains.d_gain_[i] * d_error;
+    cmd_[i] = valid ? cmd : 0.0;
+    commands[i] = cmd_[i];
+  }
+}
+
+
+void PidBank::compute_commands(const JointArray &errors, JointArray &commands, rclcpp::Duration dt)
+{
+  const double dt_s = dt.seconds();
+  if (!(dt_s > 0.0))
+  {
+    std::fill_n(commands.begin(), size_, 0.0);
+    return;
+  }
+
+  const BankGains &gains = gains_buffer_.read_from_rt();
+  derivative_count_ = std::min(derivative_count_ + 1, DERIVATIVE_WINDOW);
+  if (size_ == YUMI_ARM_JOINTS)
+  {
+    compute_joints<YUMI_ARM_JOINTS>(gains, errors, commands, dt_s);
+  }
+  else
+  {
+    compute_joints<0>(gains, errors, commands, dt_s);
+  }
+
+  derivative_slot_ = (derivative_slot_ + 1) % DERIVATIVE_WINDOW;
+}
+
+} // namespace control_utils
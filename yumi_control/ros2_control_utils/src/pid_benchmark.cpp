@@ -0,0 +1,99 @@
+// Microbenchmark of control_utils::PidBank against one control_utils::Pid per joint.
+//
+// Usage: pid_benchmark [num_joints] [num_cycles]
+
+#include <ros2_control_utils/pid.hpp>
+#include <ros2_control_utils/pid_bank.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+// Keeps the compiler from optimizing away results that are otherwise unused.
+volatile double sink;
+
+template <class Function>
+double time_per_cycle_ns(Function &&function, std::size_t num_cycles)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t cycle = 0; cycle < num_cycles; ++cycle)
+  {
+    function(cycle);
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / num_cycles;
+}
+
+} // namespace
+
+
+int main(int argc, char *argv[])
+{
+  std::size_t num_joints = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 7;
+  std::size_t num_cycles = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 1000000;
+  if (num_joints == 0 || num_joints > control_utils::PidBank::MAX_JOINTS)
+  {
+    std::fprintf(stderr, "num_joints must be between 1 and %zu\n", control_utils::PidBank::MAX_JOINTS);
+    return -1;
+  }
+
+  // Same gains as the joint_position_controller in yumi_params, but with all terms active.
+  control_utils::Pid::Gains gains(1.2, 0.5, 0.01, 4, -4, true);
+  const rclcpp::Duration dt(std::chrono::milliseconds(4));
+
+  // Pregenerated errors so that both variants see identical input.
+  constexpr std::size_t num_samples = 4096;
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<> dis(-0.1, 0.1);
+  std::vector<control_utils::PidBank::JointArray> errors(num_samples);
+  for (auto &sample : errors)
+  {
+    for (std::size_t joint = 0; joint < num_joints; ++joint)
+    {
+      sample[joint] = dis(gen);
+    }
+  }
+
+  // One heap allocated Pid per joint, as used by the controllers before PidBank.
+  std::vector<std::shared_ptr<control_utils::Pid>> pids;
+  for (std::size_t joint = 0; joint < num_joints; ++joint)
+  {
+    pids.push_back(std::make_shared<control_utils::Pid>(gains));
+  }
+  std::vector<double> pid_commands(num_joints);
+  double pid_ns = time_per_cycle_ns([&](std::size_t cycle) {
+    const auto &sample = errors[cycle % num_samples];
+    for (std::size_t joint = 0; joint < num_joints; ++joint)
+    {
+      pid_commands[joint] = pids[joint]->compute_command(sample[joint], dt);
+    }
+    sink = pid_commands[0];
+  }, num_cycles);
+
+  control_utils::PidBank bank(num_joints, gains);
+  control_utils::PidBank::JointArray bank_commands = {};
+  double bank_ns = time_per_cycle_ns([&](std::size_t cycle) {
+    bank.compute_commands(errors[cycle % num_samples], bank_commands, dt);
+    sink = bank_commands[0];
+  }, num_cycles);
+
+  // Both variants have processed the same input, so their final commands should agree.
+  double max_difference = 0.0;
+  for (std::size_t joint = 0; joint < num_joints; ++joint)
+  {
+    max_difference = std::max(max_difference, std::abs(pid_commands[joint] - bank_commands[joint]));
+  }
+
+  std::printf("joints: %zu, cycles: %zu\n", num_joints, num_cycles);
+  std::printf("Pid::compute_command per joint: %8.1f ns/cycle\n", pid_ns);
+  std::printf("PidBank::compute_commands:      %8.1f ns/cycle\n", bank_ns);
+  std::printf("speedup: %.2fx, max command difference: %g\n", pid_ns / bank_ns, max_difference);
+  return 0;
+}
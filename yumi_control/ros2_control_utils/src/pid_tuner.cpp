@@ -0,0 +1,154 @@
+#include <ros2_control_utils/pid_tuner.hpp>
+#include <algorithm>
+#include <deque>
+#include <limits>
+
+namespace control_utils
+{
+
+namespace
+{
+
+// Linear interpolation of the error at time t, with the error being 0 before the step.
+double error_at(const std::vector<double> &time, const std::vector<double> &error, double t, std::size_t &cursor)
+{
+  if (t < 0.0)
+  {
+    return 0.0;
+  }
+  while (cursor + 1 < time.size() && time[cursor + 1] <= t)
+  {
+    cursor++;
+  }
+  if (cursor + 1 >= time.size() || t < time[cursor])
+  {
+    return error[cursor];
+  }
+  double fraction = (t - time[cursor]) / (time[cursor + 1] - time[cursor]);
+  return error[cursor] + fraction * (error[cursor + 1] - error[cursor]);
+}
+
+} // namespace
+
+
+IntegratingPlant identify_integrating_plant(const std::vector<double> &time, const std::vector<double> &error,
+                                            double probe_p, double max_dead_time, double dead_time_step)
+{
+  IntegratingPlant best;
+  best.residual = std::numeric_limits<double>::infinity();
+  if (time.size() < 3 || time.size() != error.size() || probe_p <= 0 || dead_time_step <= 0)
+  {
+    return best;
+  }
+
+  for (double dead_time = 0.0; dead_time <= max_dead_time + 0.5 * dead_time_step; dead_time += dead_time_step)
+  {
+    // Least squares fit of de/dt = -k * e(t - dead_time), with de/dt taken between consecutive samples
+    double sum_xy = 0.0, sum_xx = 0.0, sum_yy = 0.0;
+    std::size_t cursor = 0, count = 0;
+    for (std::size_t k = 0; k + 1 < time.size(); ++k)
+    {
+      double dt = time[k + 1] - time[k];
+      if (dt <= 0)
+      {
+        continue;
+      }
+      double error_dot = (error[k + 1] - error[k]) / dt;
+      double delayed_error = error_at(time, error, 0.5 * (time[k] + time[k + 1]) - dead_time, cursor);
+      sum_xy += error_dot * delayed_error;
+      sum_xx += delayed_error * delayed_error;
+      sum_yy += error_dot * error_dot;
+      count++;
+    }
+    if (sum_xx <= 0 || count == 0)
+    {
+      continue;
+    }
+
+    double k = -sum_xy / sum_xx;
+    double residual = (sum_yy - k * k * sum_xx) / count;
+    if (k > 0 && residual < best.residual)
+    {
+      best.gain = k / probe_p;
+      best.dead_time = dead_time;
+      best.residual = residual;
+    }
+  }
+
+  if (best.gain == 0.0)
+  {
+    best.residual = 0.0;
+  }
+  return best;
+}
+
+
+Pid::Gains simc_gains(const IntegratingPlant &plant, double settling_time, bool use_integral, const Pid::Gains &base)
+{
+  Pid::Gains gains = base;
+  gains.p_gain_ = 0.0;
+  gains.i_gain_ = 0.0;
+  gains.d_gain_ = 0.0;
+  if (plant.gain <= 0)
+  {
+    return gains;
+  }
+
+  double tau_c = std::max((settling_time - plant.dead_time) / 4.0, plant.dead_time);
+  if (tau_c <= 0)
+  {
+    return gains;
+  }
+  gains.p_gain_ = 1.0 / (plant.gain * (tau_c + plant.dead_time));
+  if (use_integral)
+  {
+    gains.i_gain_ = gains.p_gain_ / (4.0 * (tau_c + plant.dead_time));
+  }
+  return gains;
+}
+
+
+double predict_settling_time(const IntegratingPlant &plant, const Pid::Gains &gains, double cycle_time,
+                             double horizon)
+{
+  if (cycle_time <= 0)
+  {
+    return -1.0;
+  }
+
+  Pid pid(gains);
+  const rclcpp::Duration dt(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(cycle_time)));
+  const std::size_t delay_cycles = static_cast<std::size_t>(std::round(plant.dead_time / cycle_time));
+  const std::size_t cycles = static_cast<std::size_t>(horizon / cycle_time);
+  constexpr double tolerance = 0.02;
+
+  // Unit step, commands are delayed by the dead time before reaching the plant
+  std::deque<double> in_flight(delay_cycles, 0.0);
+  double position = 0.0;
+  double settled_since = 0.0;
+  bool settled = false;
+  for (std::size_t cycle = 0; cycle < cycles; ++cycle)
+  {
+    double error = 1.0 - position;
+    if (std::abs(error) <= tolerance)
+    {
+      if (!settled)
+      {
+        settled_since = cycle * cycle_time;
+      }
+      settled = true;
+    }
+    else
+    {
+      settled = false;
+    }
+
+    in_flight.push_back(pid.compute_command(error, dt));
+    position += plant.gain * cycle_time * in_flight.front();
+    in_flight.pop_front();
+  }
+  return settled ? settled_since : -1.0;
+}
+
+} // namespace control_utils
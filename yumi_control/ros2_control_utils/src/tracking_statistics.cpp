@@ -0,0 +1,87 @@
+#include <ros2_control_utils/tracking_statistics.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace control_utils
+{
+
+TrackingStatistics::TrackingStatistics(std::size_t size, double settling_tolerance)
+    : settling_tolerance_(settling_tolerance)
+{
+  resize(size);
+}
+
+
+void TrackingStatistics::resize(std::size_t size)
+{
+  summary_ = TrackingSummary();
+  summary_.size = std::min(size, MAX_JOINTS);
+  start(0);
+}
+
+
+void TrackingStatistics::start(int64_t start_ns)
+{
+  summary_.segment++;
+  summary_.start_ns = start_ns;
+  summary_.last_sample_ns = start_ns;
+  summary_.goal_ns = -1;
+  summary_.samples = 0;
+  summary_.rms_error.fill(0.0);
+  summary_.max_error.fill(0.0);
+  summary_.goal_error.fill(0.0);
+  summary_.settling_time.fill(-1.0);
+  squared_error_sum_.fill(0.0);
+  last_unsettled_ns_.fill(0);
+}
+
+
+void TrackingStatistics::add_sample(int64_t time_ns, const JointArray &errors, bool at_goal)
+{
+  // Non finite errors, e.g. from a joint without a state, would spoil the whole segment
+  std::size_t joint_num = summary_.size;
+  for (std::size_t i = 0; i < joint_num; ++i)
+  {
+    if (!std::isfinite(errors[i]))
+    {
+      return;
+    }
+  }
+
+  summary_.samples++;
+  summary_.last_sample_ns = time_ns;
+  bool reached_goal = at_goal && summary_.goal_ns < 0;
+  if (reached_goal)
+  {
+    summary_.goal_ns = time_ns;
+  }
+
+  for (std::size_t i = 0; i < joint_num; ++i)
+  {
+    double error = std::abs(errors[i]);
+    squared_error_sum_[i] += error * error;
+    summary_.rms_error[i] = std::sqrt(squared_error_sum_[i] / summary_.samples);
+    summary_.max_error[i] = std::max(summary_.max_error[i], error);
+    if (reached_goal)
+    {
+      summary_.goal_error[i] = errors[i];
+    }
+
+    // Settled once the error stays within tolerance after the goal, the time is measured to the first sample of that
+    if (summary_.goal_ns >= 0)
+    {
+      if (error > settling_tolerance_)
+      {
+        last_unsettled_ns_[i] = time_ns;
+        summary_.settling_time[i] = -1.0;
+      }
+      else if (summary_.settling_time[i] < 0.0)
+      {
+        int64_t settled_ns = last_unsettled_ns_[i] > 0 ? time_ns : summary_.goal_ns;
+        summary_.settling_time[i] = (settled_ns - summary_.goal_ns) * 1e-9;
+      }
+    }
+  }
+}
+
+} // namespace control_utils
@@ -55,6 +55,11 @@ private:
   // Handles
   std::vector<hardware_interface::JointStateHandle> joint_state_handles_;
   std::vector<hardware_interface::JointCommandHandle> joint_command_handles_;
+  std::vector<hardware_interface::JointCommandHandle> joint_command_handles_vel_;
+  // References handed between chained controllers, e.g. from the joint_trajectory_controller to the
+  // joint_position_controller. Never sent to the robot.
+  std::vector<hardware_interface::JointCommandHandle> joint_reference_handles_;
+  std::vector<hardware_interface::JointCommandHandle> joint_reference_handles_vel_;
   std::vector<hardware_interface::OperationModeHandle> read_op_handles_;
   std::vector<hardware_interface::OperationModeHandle> write_op_handles_;
 
@@ -75,6 +80,9 @@ private:
   std::vector<double> joint_velocity_; 
   std::vector<double> joint_effort_; 
   std::vector<double> joint_position_command_; 
+  std::vector<double> joint_velocity_command_; 
+  std::vector<double> joint_position_reference_; 
+  std::vector<double> joint_velocity_reference_; 
 
   // maximum number of joints of 10 implied here
   std::array<bool, 10> read_op_; 
@@ -0,0 +1,92 @@
+// Copyright 2020 Markus Bjønnes and Marius Nilsen.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <hardware_interface/joint_command_handle.hpp>
+
+namespace abb_egm_hardware
+{
+
+/**
+ * @brief Arbitrates the joint command handles between the controllers writing them, by priority.
+ *
+ * The handles hold the last value written, so without arbitration the controller updated last wins. Instead, a
+ * controller claims a command, e.g. <joint> or <joint>_ref, together with its _vel handle, by writing CLAIM to the
+ * <command>_claim handle registered by the arbiter. The claim holds until the controller writes RELEASE there or is
+ * released by the scheduler, whatever values it writes in between. Writes to a command claimed by a controller of
+ * higher priority are undone, position and velocity together, e.g. a trajectory controller is overridden by a servo
+ * controller, and both by a safety stop. Equal priorities keep the last writer winning. Unclaimed commands are
+ * written by whoever writes them.
+ *
+ * Hand-back: a controller whose claim was taken over, or refused because a controller of higher priority holds the
+ * command, reads TAKEN from the claim handle at the start of its next update. It is to continue from the current
+ * commands instead of its own, so when the other controller releases, the joints stay where that one left them.
+ * Reported to the first 64 writers.
+ *
+ * The ownership table is only touched from the control loop, around each controller update.
+ */
+class CommandArbiter
+{
+public:
+  static constexpr double CLAIM = 1.0;
+  static constexpr double RELEASE = 0.0;
+  static constexpr double TAKEN = -1.0;
+
+  /**
+   * @brief The handles to arbitrate, e.g. all registered in the hardware. Clears all claims.
+   *
+   * A <command>_vel handle is arbitrated with <command>. The claim handles are created here, see claim_handles().
+   */
+  void set_handles(const std::vector<hardware_interface::JointCommandHandle *> & handles);
+
+  /* One <command>_claim handle per command, to be registered in the hardware before the controllers are configured. */
+  std::vector<hardware_interface::JointCommandHandle> & claim_handles() { return claim_handles_; }
+
+  /* Marks the start of the update of writer, of the given priority. */
+  void begin(int writer, int priority);
+
+  /* Marks the end of the update started by begin(). Resolves the claims and writes made in it. */
+  void end();
+
+  /* Releases the claims of writer, e.g. once it is stopped. */
+  void release(int writer);
+
+  size_t size() const { return handles_.size(); }
+
+private:
+  struct Claim
+  {
+    int owner = -1;   /**< Writer holding the claim, -1 if unclaimed. */
+    int priority = 0;
+  };
+
+  std::vector<hardware_interface::JointCommandHandle *> handles_;
+  std::vector<size_t> command_;  /**< Command of each handle. */
+  std::vector<double> before_;   /**< Values at begin(), preallocated. */
+
+  // Per command
+  std::vector<Claim> claims_;
+  std::vector<double> claim_values_;  /**< Written by the controllers, NaN at begin(). */
+  std::vector<hardware_interface::JointCommandHandle> claim_handles_;
+  std::vector<char> overridden_;
+  std::vector<uint64_t> taken_;  /**< Bit per writer whose claim was taken over or refused since its last update. */
+  int writer_ = -1;
+  int priority_ = 0;
+};
+
+}  // namespace abb_egm_hardware
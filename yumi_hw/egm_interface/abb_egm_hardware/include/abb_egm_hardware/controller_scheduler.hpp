@@ -0,0 +1,148 @@
+// Copyright 2020 Markus Bjønnes and Marius Nilsen.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <rclcpp/rclcpp.hpp>
+#include <controller_interface/controller_interface.hpp>
+#include <controller_manager/controller_manager.hpp>
+#include <hardware_interface/robot_hardware.hpp>
+#include <ros2_control_interfaces/srv/switch_controllers.hpp>
+#include <abb_egm_hardware/command_arbiter.hpp>
+
+namespace abb_egm_hardware
+{
+
+/**
+ * @brief Updates the loaded controllers at integer fractions of the control rate, in place of
+ * ControllerManager::update().
+ *
+ * A controller with divisor n is updated every n-th cycle, in the cycles whose number modulo n is its phase. Without
+ * a given phase the one sharing the fewest cycles with the controllers already added is picked, so low rate
+ * controllers are spread over the cycles instead of all landing in the same one.
+ *
+ * Controllers commanding the same joints, e.g. the joint_trajectory_controller and a joint_position_controller, can
+ * be swapped while the loop runs. Only running controllers are updated, and switch_controllers() starts and stops
+ * them between two cycles, so the joint commands are written by the outgoing controllers in one cycle and by the
+ * incoming ones in the next.
+ *
+ * Controllers running side by side, e.g. the joint_trajectory_controller and the cartesian_velocity_controller, have
+ * their joint commands arbitrated by priority, see CommandArbiter. Switching a controller out releases its claims.
+ */
+class ControllerScheduler
+{
+public:
+  ~ControllerScheduler();
+
+  /**
+   * @brief Schedules the controllers loaded by controller_manager and brings them up, as the hardware nodes do.
+   *
+   * Each controller is given the namespace parameter and added with its update_divisor, update_phase, autostart and
+   * command_priority parameters. The command handles of robot are arbitrated and the claim handles registered with
+   * it. The controllers are then configured and activated, the ones without autostart deactivated again, and
+   * <nodegroup_namespace>/controller_scheduler/switch_controllers is served from a thread of its own. The executor of
+   * the controllers must be spinning. Returns false if a controller fails to configure or activate.
+   */
+  bool setup(std::shared_ptr<hardware_interface::RobotHardware> robot,
+             controller_manager::ControllerManager & controller_manager, const std::string & nodegroup_namespace);
+
+  /**
+   * @brief Adds controller, updated after the ones added before it. A negative phase is picked, a given one is
+   * wrapped. A controller not running is not updated until it is switched to. Its joint commands override the ones
+   * of controllers with a lower priority.
+   */
+  void add(std::shared_ptr<controller_interface::ControllerInterface> controller, unsigned int divisor, int phase = -1,
+           bool running = true, int priority = 0);
+
+  /* The joint command handles arbitrated between the controllers, none by default. */
+  void set_command_handles(const std::vector<hardware_interface::JointCommandHandle *> & handles);
+
+  /* The claim handles of the arbitrated commands, for the hardware to register. See CommandArbiter. */
+  std::vector<hardware_interface::JointCommandHandle> & claim_handles() { return arbiter_.claim_handles(); }
+
+  /* Updates the running controllers due in this cycle and advances to the next. Returns the last failure, if any. */
+  controller_interface::controller_interface_ret_t update();
+
+  /**
+   * @brief Stops the controllers named in stop and starts the ones named in start, between two cycles of update().
+   *
+   * Not realtime, blocks until the control loop has made the switch. The started controllers are activated before
+   * the switch and the stopped ones deactivated after it, so a controller is never updated while inactive. Fails
+   * without changing anything if a controller is unknown, in the wrong state, fails to activate or the control loop
+   * does not make the switch within timeout.
+   *
+   * The transitions are run by the executor of the controllers, in the default callback group of each controller's
+   * node, so they are serialized with its timers and subscriptions. Must not be called from that executor.
+   */
+  bool switch_controllers(const std::vector<std::string> & start, const std::vector<std::string> & stop,
+                          std::chrono::nanoseconds timeout, std::string & error);
+
+  size_t size() const { return entries_.size(); }
+
+  /* Divisor and phase of the i-th controller added. */
+  unsigned int divisor(size_t i) const { return entries_[i].divisor; }
+  unsigned int phase(size_t i) const { return entries_[i].phase; }
+  int priority(size_t i) const { return entries_[i].priority; }
+
+  /* Whether the i-th controller added is running as of the last switch. Not realtime. */
+  bool running(size_t i) const { return running_[i]; }
+
+private:
+  struct Entry
+  {
+    std::shared_ptr<controller_interface::ControllerInterface> controller;
+    unsigned int divisor;
+    unsigned int phase;
+    int priority;
+    bool running;  /**< Owned by update(). */
+  };
+
+  // A switch is requested by switch_controllers() and claimed and made by update()
+  enum SwitchState
+  {
+    NO_SWITCH,
+    SWITCH_REQUESTED,
+    SWITCH_CLAIMED
+  };
+
+  int find(const std::string & name) const;
+
+  /* Activates or deactivates the i-th controller in its default callback group. Returns whether it got there. */
+  bool transition(size_t i, bool activate);
+
+  std::vector<Entry> entries_;
+  uint64_t cycle_ = 0;
+  CommandArbiter arbiter_;
+
+  std::mutex switch_mutex_;          /**< Serializes switch_controllers(). */
+  std::vector<char> running_;        /**< Non realtime copy of the running flags, as of the last switch. */
+  std::vector<char> requested_;      /**< Running flags after the requested switch, read by update() once claimed. */
+  std::atomic<int> switch_state_{NO_SWITCH};
+
+  // The switch service waits for the transitions and the control loop, so it is spun apart from the controllers
+  rclcpp::Node::SharedPtr node_;
+  rclcpp::Service<ros2_control_interfaces::srv::SwitchControllers>::SharedPtr switch_service_;
+  std::shared_ptr<rclcpp::executors::SingleThreadedExecutor> switch_executor_;
+  std::thread switch_thread_;
+};
+
+}  // namespace abb_egm_hardware
@@ -105,6 +105,25 @@ namespace abb_egm_hardware
         return ret;
       }
 
+      joint_reference_handles_[i] = hardware_interface::JointCommandHandle(joint_names_[i] + "_ref", 
+                                                                           &joint_position_reference_[i]);
+      ret = register_joint_command_handle(&joint_reference_handles_[i]);
+      if (ret != hardware_interface::HW_RET_OK)
+      {
+        RCLCPP_WARN(node_->get_logger(), "Can't register joint command handle %s", (joint_names_[i] + "_ref").c_str());
+        return ret;
+      }
+
+      joint_reference_handles_vel_[i] = hardware_interface::JointCommandHandle(joint_names_[i] + "_ref_vel", 
+                                                                               &joint_velocity_reference_[i]);
+      ret = register_joint_command_handle(&joint_reference_handles_vel_[i]);
+      if (ret != hardware_interface::HW_RET_OK)
+      {
+        RCLCPP_WARN(node_->get_logger(), "Can't register joint command handle %s", 
+                    (joint_names_[i] + "_ref_vel").c_str());
+        return ret;
+      }
+
       read_op_handles_[i] = hardware_interface::OperationModeHandle(
           read_op_handle_names_[i], reinterpret_cast<hardware_interface::OperationMode *>(&read_op_[i]));
 
@@ -196,6 +215,7 @@ namespace abb_egm_hardware
         {
           joint_position_command_[index] = angles::from_degrees(initial_position.values(index));
           joint_velocity_command_[index] = angles::from_degrees(initial_velocity.values(index));
+          joint_position_reference_[index] = joint_position_command_[index];
         }
 
         // clear command_ to be sure it is empty
@@ -412,6 +432,8 @@ namespace abb_egm_hardware
     joint_state_handles_.resize(n_joints_);
     joint_command_handles_.resize(n_joints_);
     joint_command_handles_vel_.resize(n_joints_);
+    joint_reference_handles_.resize(n_joints_);
+    joint_reference_handles_vel_.resize(n_joints_);
     read_op_handles_.resize(n_joints_);
     write_op_handles_.resize(n_joints_);
     read_op_ = new bool[n_joints_];
@@ -423,6 +445,8 @@ namespace abb_egm_hardware
     joint_effort_.assign(n_joints_, 0.0);
     joint_position_command_.assign(n_joints_, 0.0);
     joint_velocity_command_.assign(n_joints_, 0.0);
+    joint_position_reference_.assign(n_joints_, 0.0);
+    joint_velocity_reference_.assign(n_joints_, 0.0);
 
     for (int i = 0; i < n_joints_; ++i)
     {
@@ -101,6 +101,34 @@ AbbEgmHardware::init()
       return ret;
     }
 
+    joint_command_handles_vel_[i] = hardware_interface::JointCommandHandle(joint_names_[i] + "_vel", 
+                                                                           &joint_velocity_command_[i]);
+    ret = register_joint_command_handle(&joint_command_handles_vel_[i]);
+    if (ret != hardware_interface::HW_RET_OK)
+    {
+      RCLCPP_WARN(node_->get_logger(), "Can't register joint command handle %s", (joint_names_[i] + "_vel").c_str());
+      return ret;
+    }
+
+    joint_reference_handles_[i] = hardware_interface::JointCommandHandle(joint_names_[i] + "_ref", 
+                                                                         &joint_position_reference_[i]);
+    ret = register_joint_command_handle(&joint_reference_handles_[i]);
+    if (ret != hardware_interface::HW_RET_OK)
+    {
+      RCLCPP_WARN(node_->get_logger(), "Can't register joint command handle %s", (joint_names_[i] + "_ref").c_str());
+      return ret;
+    }
+
+    joint_reference_handles_vel_[i] = hardware_interface::JointCommandHandle(joint_names_[i] + "_ref_vel", 
+                                                                             &joint_velocity_reference_[i]);
+    ret = register_joint_command_handle(&joint_reference_handles_vel_[i]);
+    if (ret != hardware_interface::HW_RET_OK)
+    {
+      RCLCPP_WARN(node_->get_logger(), "Can't register joint command handle %s", 
+                  (joint_names_[i] + "_ref_vel").c_str());
+      return ret;
+    }
+
     read_op_handles_[i] = hardware_interface::OperationModeHandle(
         read_op_handle_names_[i], reinterpret_cast<hardware_interface::OperationMode*>(&read_op_[i]));
 
@@ -141,6 +169,7 @@ AbbEgmHardware::write()
 	for (size_t index = 0; index < n_joints_; ++index)
 	{
     joint_position_[index] = joint_position_command_[index];
+    joint_velocity_[index] = joint_velocity_command_[index];
 	}
 	return hardware_interface::HW_RET_OK;
 }
@@ -328,10 +357,16 @@ AbbEgmHardware::initialize_vectors()
   joint_position_command_ = joint_position_;
   joint_velocity_.assign(n_joints_, 0.0);
   joint_effort_.assign(n_joints_, 0.0);
+  joint_velocity_command_.assign(n_joints_, 0.0);
+  joint_position_reference_ = joint_position_;
+  joint_velocity_reference_.assign(n_joints_, 0.0);
 
   // Resize handle vectors
   joint_state_handles_.resize(n_joints_);
   joint_command_handles_.resize(n_joints_);
+  joint_command_handles_vel_.resize(n_joints_);
+  joint_reference_handles_.resize(n_joints_);
+  joint_reference_handles_vel_.resize(n_joints_);
   read_op_handles_.resize(n_joints_);
   write_op_handles_.resize(n_joints_);
  
@@ -14,6 +14,7 @@
 
 #include <rclcpp/rclcpp.hpp>
 #include "controller_manager/controller_manager.hpp"
+#include "abb_egm_hardware/controller_scheduler.hpp"
 #include "abb_egm_hardware/abb_egm_hardware.hpp"
 
 
@@ -49,33 +50,33 @@ int main(int argc, char* argv[])
   controller_manager.load_controller("controllers", "ros_controllers::JointTrajectoryController",
                                      "joint_trajectory_controller");
 
-  // Pass namespace to controllers as well
-  auto controllers = controller_manager.get_loaded_controller();
-  for(auto c : controllers)
+  // Only commands the joints while TCP twists are streamed, so it overrides the trajectory controller
+  controller_manager.load_controller("controllers", "ros_controllers::CartesianVelocityController",
+                                     "cartesian_velocity_controller");
+
+  // Lead-through, only commands the joints while enabled. Not loaded for an arm without external joint torques.
+  if (controller_manager.declare_parameter<bool>("load_admittance_controller", true))
   {
-    auto l_node = c->get_lifecycle_node();
-    l_node->declare_parameter("namespace", nodegroup_namespace);
+    controller_manager.load_controller("controllers", "ros_controllers::AdmittanceController",
+                                       "admittance_controller");
   }
 
+  // With command_interface reference the controllers above write the joint reference handles, and are chained to the
+  // joint position controller closing the loop on them. Controllers are updated in load order, so it follows.
+  // Otherwise it is loaded without autostart, to be switched to in place of the trajectory controller.
+  controller_manager.load_controller("controllers", "ros_controllers::JointPositionController",
+                                     "joint_position_controller");
+
   // there is no async spinner in ROS 2, so we have to put the spin() in its own thread
   auto future_handle = std::async(std::launch::async, spin, executor);
 
-  // Controller manager transitions the cotnrollers lifecycle node from Unconfigured to Inactive state
-  // by calling their respective on_configured() functions.
-  if (controller_manager.configure() != controller_interface::CONTROLLER_INTERFACE_RET_SUCCESS)
+  // Controller manager transitions the controllers through their lifecycle, and the scheduler updates them
+  abb_egm_hardware::ControllerScheduler scheduler;
+  if (!scheduler.setup(robot, controller_manager, nodegroup_namespace))
   {
-    RCLCPP_ERROR(controller_manager.get_logger(), "at least one controller failed to configure"); 
     return -1;
   }
 
-  // Controller manager transitions the controllers lifecycle nodes from Inactive to Active state.
-  // by running their respective on_activate() funcitons.
-  if (controller_manager.activate() != controller_interface::CONTROLLER_INTERFACE_RET_SUCCESS)
-  {
-    RCLCPP_ERROR(controller_manager.get_logger(), "at least one controller failed to activate");
-    return -1;
-  }
-  
   std::cout << "Entering EGM control loop" << std::endl;
   // Real-time control loop
   rclcpp::WallRate loop_rate(250);
@@ -89,7 +90,7 @@ int main(int argc, char* argv[])
     }
 
     // (joint_position_controller): Updates joint_position_command_ 
-    controller_manager.update();
+    scheduler.update();
 
     // Writes the contents of joint_position_command_ to robot
     ret = robot->write();
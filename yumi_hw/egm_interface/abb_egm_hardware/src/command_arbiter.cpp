@@ -0,0 +1,142 @@
+// Copyright 2020 Markus Bjønnes and Marius Nilsen.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <abb_egm_hardware/command_arbiter.hpp>
+#include <algorithm>
+#include <limits>
+
+namespace abb_egm_hardware
+{
+
+namespace
+{
+const std::string VEL_SUFFIX = "_vel";
+
+uint64_t writer_bit(int writer)
+{
+  return writer >= 0 && writer < 64 ? uint64_t(1) << writer : 0;
+}
+}
+
+void CommandArbiter::set_handles(const std::vector<hardware_interface::JointCommandHandle *> & handles)
+{
+  handles_ = handles;
+  before_.assign(handles_.size(), 0.0);
+
+  // A handle is a command of its own unless it is the _vel handle of another one
+  std::vector<std::string> names;
+  command_.assign(handles_.size(), 0);
+  for (size_t i = 0; i < handles_.size(); ++i)
+  {
+    const auto & name = handles_[i]->get_name();
+    bool velocity = name.size() > VEL_SUFFIX.size() &&
+      name.compare(name.size() - VEL_SUFFIX.size(), VEL_SUFFIX.size(), VEL_SUFFIX) == 0;
+    std::string command = velocity ? name.substr(0, name.size() - VEL_SUFFIX.size()) : name;
+    bool has_position = false;
+    for (auto * handle : handles_)
+    {
+      has_position = has_position || handle->get_name() == command;
+    }
+    if (!has_position)
+    {
+      command = name;
+    }
+
+    size_t index = 0;
+    while (index < names.size() && names[index] != command)
+    {
+      ++index;
+    }
+    if (index == names.size())
+    {
+      names.push_back(command);
+    }
+    command_[i] = index;
+  }
+
+  claims_.assign(names.size(), Claim());
+  claim_values_.assign(names.size(), std::numeric_limits<double>::quiet_NaN());
+  overridden_.assign(names.size(), false);
+  taken_.assign(names.size(), 0);
+  // Sized once, the handles point into claim_values_
+  claim_handles_.clear();
+  claim_handles_.reserve(names.size());
+  for (size_t c = 0; c < names.size(); ++c)
+  {
+    claim_handles_.emplace_back(names[c] + "_claim", &claim_values_[c]);
+  }
+}
+
+void CommandArbiter::begin(int writer, int priority)
+{
+  writer_ = writer;
+  priority_ = priority;
+  for (size_t i = 0; i < handles_.size(); ++i)
+  {
+    before_[i] = handles_[i]->get_cmd();
+  }
+  uint64_t bit = writer_bit(writer);
+  for (size_t c = 0; c < claims_.size(); ++c)
+  {
+    claim_values_[c] = (taken_[c] & bit) ? TAKEN : std::numeric_limits<double>::quiet_NaN();
+    taken_[c] &= ~bit;
+  }
+}
+
+void CommandArbiter::end()
+{
+  for (size_t c = 0; c < claims_.size(); ++c)
+  {
+    auto & claim = claims_[c];
+    overridden_[c] = claim.owner >= 0 && claim.owner != writer_ && claim.priority > priority_;
+    if (overridden_[c])
+    {
+      taken_[c] |= claim_values_[c] == CLAIM ? writer_bit(writer_) : 0;
+      continue;
+    }
+    if (claim_values_[c] == CLAIM)
+    {
+      taken_[c] |= claim.owner != writer_ ? writer_bit(claim.owner) : 0;
+      claim.owner = writer_;
+      claim.priority = priority_;
+    }
+    else if (claim_values_[c] == RELEASE && claim.owner == writer_)
+    {
+      claim.owner = -1;
+    }
+  }
+
+  // Writes to an overridden command are undone, position and velocity alike
+  for (size_t i = 0; i < handles_.size(); ++i)
+  {
+    if (overridden_[command_[i]])
+    {
+      handles_[i]->set_cmd(before_[i]);
+    }
+  }
+  writer_ = -1;
+}
+
+void CommandArbiter::release(int writer)
+{
+  for (auto & claim : claims_)
+  {
+    if (claim.owner == writer)
+    {
+      claim.owner = -1;
+    }
+  }
+}
+
+}  // namespace abb_egm_hardware
@@ -0,0 +1,321 @@
+// Copyright 2020 Markus Bjønnes and Marius Nilsen.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <abb_egm_hardware/controller_scheduler.hpp>
+#include <algorithm>
+#include <future>
+#include <limits>
+#include <numeric>
+#include <lifecycle_msgs/msg/state.hpp>
+
+namespace abb_egm_hardware
+{
+
+ControllerScheduler::~ControllerScheduler()
+{
+  if (switch_thread_.joinable())
+  {
+    switch_executor_->cancel();
+    switch_thread_.join();
+  }
+}
+
+bool ControllerScheduler::setup(std::shared_ptr<hardware_interface::RobotHardware> robot,
+                                controller_manager::ControllerManager & controller_manager,
+                                const std::string & nodegroup_namespace)
+{
+  // Pass namespace to controllers as well. Each controller is updated every update_divisor-th cycle, in the cycles
+  // given by update_phase, or spread over the cycles with the default -1. Without autostart it is not updated until
+  // it is switched to. Joint commands claimed through the <command>_claim handles go to the claiming controller of
+  // highest command_priority.
+  set_command_handles(robot->get_registered_joint_command_handles());
+  for (auto & claim_handle : claim_handles())
+  {
+    robot->register_joint_command_handle(&claim_handle);
+  }
+  auto controllers = controller_manager.get_loaded_controller();
+  for (auto c : controllers)
+  {
+    auto l_node = c->get_lifecycle_node();
+    l_node->declare_parameter("namespace", nodegroup_namespace);
+    auto divisor = l_node->declare_parameter<int>("update_divisor", 1);
+    auto phase = l_node->declare_parameter<int>("update_phase", -1);
+    auto autostart = l_node->declare_parameter<bool>("autostart", true);
+    auto priority = l_node->declare_parameter<int>("command_priority", 0);
+    add(c, static_cast<unsigned int>(std::max(divisor, 1)), phase, autostart, priority);
+    RCLCPP_INFO(controller_manager.get_logger(), "%s updated every %u. cycle, phase %u, command priority %d",
+                l_node->get_name(), this->divisor(size() - 1), this->phase(size() - 1), this->priority(size() - 1));
+  }
+
+  // Controller manager transitions the controllers lifecycle node from Unconfigured to Inactive state
+  // by calling their respective on_configured() functions.
+  if (controller_manager.configure() != controller_interface::CONTROLLER_INTERFACE_RET_SUCCESS)
+  {
+    RCLCPP_ERROR(controller_manager.get_logger(), "at least one controller failed to configure");
+    return false;
+  }
+
+  // Controller manager transitions the controllers lifecycle nodes from Inactive to Active state.
+  // by running their respective on_activate() functions.
+  if (controller_manager.activate() != controller_interface::CONTROLLER_INTERFACE_RET_SUCCESS)
+  {
+    RCLCPP_ERROR(controller_manager.get_logger(), "at least one controller failed to activate");
+    return false;
+  }
+
+  // Controllers without autostart wait inactive until they are switched to
+  for (size_t i = 0; i < size(); ++i)
+  {
+    if (!running(i))
+    {
+      transition(i, false);
+    }
+  }
+
+  // Controllers are switched between two cycles of the control loop, so the joints are commanded in every cycle
+  node_ = std::make_shared<rclcpp::Node>("controller_scheduler", nodegroup_namespace);
+  switch_service_ = node_->create_service<ros2_control_interfaces::srv::SwitchControllers>(
+    "~/switch_controllers",
+    [this](const std::shared_ptr<ros2_control_interfaces::srv::SwitchControllers::Request> request,
+           std::shared_ptr<ros2_control_interfaces::srv::SwitchControllers::Response> response)
+    {
+      response->ok = switch_controllers(request->start_controllers, request->stop_controllers,
+                                        std::chrono::seconds(1), response->message);
+    });
+  switch_executor_ = std::make_shared<rclcpp::executors::SingleThreadedExecutor>();
+  switch_executor_->add_node(node_);
+  switch_thread_ = std::thread([this]() { switch_executor_->spin(); });
+  return true;
+}
+
+void ControllerScheduler::add(std::shared_ptr<controller_interface::ControllerInterface> controller,
+                              unsigned int divisor, int phase, bool running, int priority)
+{
+  divisor = std::max(divisor, 1u);
+  running_.push_back(running);
+  requested_.push_back(running);
+  if (phase >= 0)
+  {
+    entries_.push_back({controller, divisor, static_cast<unsigned int>(phase) % divisor, priority, running});
+    return;
+  }
+
+  // Two controllers share a cycle whenever their phases agree modulo the gcd of their divisors, which happens in
+  // gcd / other divisor of the cycles of this one. The phase with the fewest controllers expected in its cycles wins.
+  unsigned int best_phase = 0;
+  double best_load = std::numeric_limits<double>::infinity();
+  for (unsigned int candidate = 0; candidate < divisor; ++candidate)
+  {
+    double load = 0.0;
+    for (const auto & entry : entries_)
+    {
+      unsigned int gcd = std::gcd(divisor, entry.divisor);
+      if (candidate % gcd == entry.phase % gcd)
+      {
+        load += static_cast<double>(gcd) / entry.divisor;
+      }
+    }
+    if (load < best_load)
+    {
+      best_load = load;
+      best_phase = candidate;
+    }
+  }
+  entries_.push_back({controller, divisor, best_phase, priority, running});
+}
+
+void ControllerScheduler::set_command_handles(const std::vector<hardware_interface::JointCommandHandle *> & handles)
+{
+  arbiter_.set_handles(handles);
+}
+
+controller_interface::controller_interface_ret_t ControllerScheduler::update()
+{
+  // A requested switch is made before any controller is updated, so no cycle goes without or with both
+  int expected = SWITCH_REQUESTED;
+  if (switch_state_.compare_exchange_strong(expected, SWITCH_CLAIMED, std::memory_order_acquire))
+  {
+    for (size_t i = 0; i < entries_.size(); ++i)
+    {
+      // Stopped controllers hand their joint commands over
+      if (entries_[i].running && !requested_[i])
+      {
+        arbiter_.release(static_cast<int>(i));
+      }
+      entries_[i].running = requested_[i];
+    }
+    switch_state_.store(NO_SWITCH, std::memory_order_release);
+  }
+
+  auto ret = controller_interface::CONTROLLER_INTERFACE_RET_SUCCESS;
+  for (size_t i = 0; i < entries_.size(); ++i)
+  {
+    const auto & entry = entries_[i];
+    if (!entry.running || cycle_ % entry.divisor != entry.phase)
+    {
+      continue;
+    }
+    arbiter_.begin(static_cast<int>(i), entry.priority);
+    auto controller_ret = entry.controller->update();
+    arbiter_.end();
+    if (controller_ret != controller_interface::CONTROLLER_INTERFACE_RET_SUCCESS)
+    {
+      ret = controller_ret;
+    }
+  }
+  ++cycle_;
+  return ret;
+}
+
+bool ControllerScheduler::switch_controllers(const std::vector<std::string> & start,
+                                             const std::vector<std::string> & stop,
+                                             std::chrono::nanoseconds timeout, std::string & error)
+{
+  std::lock_guard<std::mutex> lock(switch_mutex_);
+
+  std::vector<char> requested = running_;
+  for (const auto & name : stop)
+  {
+    int index = find(name);
+    if (index < 0 || !running_[index])
+    {
+      error = name + (index < 0 ? " is not loaded" : " is not running");
+      return false;
+    }
+    requested[index] = false;
+  }
+  for (const auto & name : start)
+  {
+    int index = find(name);
+    if (index < 0 || running_[index])
+    {
+      error = name + (index < 0 ? " is not loaded" : " is already running");
+      return false;
+    }
+    requested[index] = true;
+  }
+
+  // Activated while not updated yet, so the incoming controllers pick up the commands as the outgoing ones leave them
+  std::vector<size_t> activated;
+  auto deactivate_started = [this, &activated]()
+  {
+    for (auto index : activated)
+    {
+      transition(index, false);
+    }
+  };
+  for (size_t i = 0; i < entries_.size(); ++i)
+  {
+    if (!requested[i] || running_[i])
+    {
+      continue;
+    }
+    if (!transition(i, true))
+    {
+      error = std::string(entries_[i].controller->get_lifecycle_node()->get_name()) + " failed to activate";
+      deactivate_started();
+      return false;
+    }
+    activated.push_back(i);
+  }
+
+  requested_ = requested;
+  switch_state_.store(SWITCH_REQUESTED, std::memory_order_release);
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (switch_state_.load(std::memory_order_acquire) != NO_SWITCH)
+  {
+    // Withdrawn unless the control loop has claimed it in the meantime
+    int expected = SWITCH_REQUESTED;
+    if (std::chrono::steady_clock::now() > deadline && switch_state_.compare_exchange_strong(expected, NO_SWITCH))
+    {
+      error = "the control loop did not switch within the timeout";
+      deactivate_started();
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  // No longer updated, the outgoing controllers are deactivated without them writing the commands again
+  for (size_t i = 0; i < entries_.size(); ++i)
+  {
+    if (running_[i] && !requested[i])
+    {
+      transition(i, false);
+    }
+  }
+  running_ = requested;
+  return true;
+}
+
+bool ControllerScheduler::transition(size_t i, bool activate)
+{
+  // Run by a one shot timer, which shares the default callback group with the other callbacks of the controller. The
+  // timer is handed to its callback under the mutex, so the callback can cancel it before it fires again.
+  struct Transition
+  {
+    std::mutex mutex;
+    std::weak_ptr<rclcpp::TimerBase> timer;
+    std::promise<bool> done;
+  };
+  auto state = std::make_shared<Transition>();
+  auto future = state->done.get_future();
+  auto node = entries_[i].controller->get_lifecycle_node();
+  std::weak_ptr<rclcpp_lifecycle::LifecycleNode> weak_node = node;
+  rclcpp::TimerBase::SharedPtr timer;
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    timer = node->create_wall_timer(std::chrono::nanoseconds(0), [state, weak_node, activate]()
+    {
+      {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        auto timer = state->timer.lock();
+        if (!timer || timer->is_canceled())
+        {
+          return;
+        }
+        timer->cancel();
+      }
+      auto node = weak_node.lock();
+      auto id = !node ? 0 : activate ? node->activate().id() : node->deactivate().id();
+      state->done.set_value(id == (activate ? lifecycle_msgs::msg::State::PRIMARY_STATE_ACTIVE :
+                                              lifecycle_msgs::msg::State::PRIMARY_STATE_INACTIVE));
+    });
+    state->timer = timer;
+  }
+
+  // Activating may take a while, e.g. the joint_position_controller fetches its gains
+  while (future.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready)
+  {
+    if (!rclcpp::ok())
+    {
+      timer->cancel();
+      return false;
+    }
+  }
+  return future.get();
+}
+
+int ControllerScheduler::find(const std::string & name) const
+{
+  for (size_t i = 0; i < entries_.size(); ++i)
+  {
+    if (name == entries_[i].controller->get_lifecycle_node()->get_name())
+    {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+}  // namespace abb_egm_hardware
@@ -40,6 +40,7 @@ def generate_launch_description():
     
     urdf = os.path.join(get_package_share_directory('yumi_description'), 'urdf', 'yumi.urdf')
     assert os.path.exists(urdf)
+    robot_description_path = {'robot_description_path' : urdf}
 
     robot_description_config = load_file('yumi_description', 'urdf/yumi.urdf')
     robot_description = {'robot_description' : robot_description_config}
@@ -63,7 +64,7 @@ def generate_launch_description():
                                      node_namespace='/l',
                                      arguments=['/l'],
                                      output='screen',
-                                     parameters=[os.path.join(get_package_share_directory("yumi_launch"), "config", "yumi_left_controllers.yaml"),
+                                     parameters=[os.path.join(get_package_share_directory("yumi_launch"), "config", "yumi_left_controllers.yaml"), robot_description_path,
                                                  os.path.join(get_package_share_directory("yumi_launch"), "config", "start_positions_left.yaml")])
     
     param_server_left =  Node(package='parameter_server', 
@@ -82,7 +83,7 @@ def generate_launch_description():
                                       node_namespace='/r',
                                       arguments=['/r'],
                                       output='screen',
-                                      parameters=[os.path.join(get_package_share_directory("yumi_launch"), "config", "yumi_right_controllers.yaml"),
+                                      parameters=[os.path.join(get_package_share_directory("yumi_launch"), "config", "yumi_right_controllers.yaml"), robot_description_path,
                                                   os.path.join(get_package_share_directory("yumi_launch"), "config", "start_positions_right.yaml")])
     
     param_server_right = Node(package='parameter_server', 
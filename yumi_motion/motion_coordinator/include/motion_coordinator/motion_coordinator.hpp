@@ -19,6 +19,9 @@
 #include <rws_clients/gripper_client.hpp>
 #include <kdl_wrapper/kdl_wrapper.h>
 #include <rclcpp/parameter.hpp>
+#include <std_msgs/msg/bool.hpp>
+#include <std_msgs/msg/float64.hpp>
+#include <atomic>
 
 
 namespace motion_coordinator
@@ -178,9 +181,37 @@ public:
   /* Return whether a planning_component is moving. */
   bool planning_component_in_motion(std::string planning_component);
 
-  /* Stops the execution a planning component's trajectory. */
+  /** 
+   * Stops the execution a planning component's trajectory. 
+   * 
+   * The joint_trajectory_controller decelerates the arm to rest, and motion is allowed again once the controller 
+   * reports it stationary, or after stop_timeout_.
+   */
   void stop(std::string planning_component);
 
+  /**
+   * Scales the speed of the trajectory a planning component is executing, without replanning it.
+   * 
+   * The joint_trajectory_controller ramps to the new scale with bounded jerk, and keeps it for later trajectories.
+   * 
+   * @param scale fraction of the planned speed, 0 pauses the motion. Limited by the max_speed_scale parameter of the
+   *              controller.
+   */
+  void set_speed_override(std::string planning_component, double scale);
+
+  /**
+   * Guards the motion of a planning component against contact.
+   * 
+   * The joint_trajectory_controller stops the trajectory being executed within a control cycle once the estimated TCP
+   * force exceeds the threshold, and publishes the joint state at contact on ~/contact.
+   * 
+   * Only the right arm has a force source. Fails without guarding either arm for left_arm and both_arms.
+   * 
+   * @param force_threshold [N], 0 removes the guard.
+   * @return whether the guard was set.
+   */
+  bool set_contact_guard(std::string planning_component, double force_threshold);
+
   /* Add a registered object to the planning scene. */
   void add_object(std::string object_id, std::vector<double> pose, bool eulerzyx, std::vector<float> rgba = {});
 
@@ -214,10 +245,17 @@ private:
   std::shared_ptr<moveit2_wrapper::ObjectManager> object_manager_;
   std::shared_ptr<KdlWrapper> kdl_wrapper_;
   rclcpp::Subscription<sensor_msgs::msg::JointState>::SharedPtr joint_state_subscription_;
+  rclcpp::Publisher<std_msgs::msg::Float64>::SharedPtr left_speed_scaling_publisher_;
+  rclcpp::Publisher<std_msgs::msg::Float64>::SharedPtr right_speed_scaling_publisher_;
+  rclcpp::Publisher<std_msgs::msg::Float64>::SharedPtr right_contact_guard_publisher_;
+  rclcpp::Subscription<std_msgs::msg::Bool>::SharedPtr left_stopped_subscription_;
+  rclcpp::Subscription<std_msgs::msg::Bool>::SharedPtr right_stopped_subscription_;
+  std::atomic<bool> left_stopped_{false};
+  std::atomic<bool> right_stopped_{false};
 
   bool should_stop_ = false;
   bool robot_ready_ = false;
-  double replan_delay_ = 1.0;
+  double stop_timeout_ = 5.0;
   double grip_margin_ = 0.003;
   std::mutex should_replan_mutex_;
 
@@ -34,6 +34,18 @@ bool MotionCoordinator::init()
   moveit2_wrapper_ = std::make_shared<moveit2_wrapper::Moveit2Wrapper>(node_);
   joint_state_subscription_ = node_->create_subscription<sensor_msgs::msg::JointState>("joint_states", 
     10, std::bind(&MotionCoordinator::joint_state_callback, this, std::placeholders::_1));
+  left_speed_scaling_publisher_ = node_->create_publisher<std_msgs::msg::Float64>(
+    "/l/joint_trajectory_controller/speed_scaling", 10);
+  right_speed_scaling_publisher_ = node_->create_publisher<std_msgs::msg::Float64>(
+    "/r/joint_trajectory_controller/speed_scaling", 10);
+  right_contact_guard_publisher_ = node_->create_publisher<std_msgs::msg::Float64>(
+    "/r/joint_trajectory_controller/contact_force_threshold", 10);
+  left_stopped_subscription_ = node_->create_subscription<std_msgs::msg::Bool>(
+    "/l/joint_trajectory_controller/stopped", rclcpp::QoS(1).transient_local(), 
+    [this](std_msgs::msg::Bool::UniquePtr msg) { left_stopped_ = msg->data; });
+  right_stopped_subscription_ = node_->create_subscription<std_msgs::msg::Bool>(
+    "/r/joint_trajectory_controller/stopped", rclcpp::QoS(1).transient_local(), 
+    [this](std_msgs::msg::Bool::UniquePtr msg) { right_stopped_ = msg->data; });
 
   
   rclcpp::Parameter param = node_->get_parameter("robot_description_path");
@@ -738,12 +750,63 @@ bool MotionCoordinator::planning_component_in_motion(std::string planning_compon
 
 void MotionCoordinator::stop(std::string planning_component)
 {
+  bool left = planning_component == "left_arm" || planning_component == "both_arms";
+  bool right = planning_component == "right_arm" || planning_component == "both_arms";
+  // The controllers report again once the stop is received, so older reports are discarded
+  left_stopped_ = false;
+  right_stopped_ = false;
   stop_motion(planning_component);
-  sleep(replan_delay_);
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(stop_timeout_);
+  while ((left && !left_stopped_) || (right && !right_stopped_))
+  {
+    if (std::chrono::steady_clock::now() > deadline)
+    {
+      std::cout << "[WARNING] " << planning_component << " not reported stopped within " << stop_timeout_ 
+                << " s" << std::endl;
+      break;
+    }
+    rclcpp::sleep_for(std::chrono::milliseconds(10));
+  }
   allow_motion(planning_component);
 }
 
 
+void MotionCoordinator::set_speed_override(std::string planning_component, double scale)
+{
+  std_msgs::msg::Float64 msg;
+  msg.data = scale;
+  if(planning_component == "left_arm" || planning_component == "both_arms")
+  {
+    left_speed_scaling_publisher_->publish(msg);
+  }
+  if(planning_component == "right_arm" || planning_component == "both_arms")
+  {
+    right_speed_scaling_publisher_->publish(msg);
+  }
+}
+
+
+bool MotionCoordinator::set_contact_guard(std::string planning_component, double force_threshold)
+{
+  // Only the right arm's TCP wrench and external joint torques are published
+  if(planning_component == "left_arm" || planning_component == "both_arms")
+  {
+    std::cout << "[ERROR] The left arm has no force source, its contact guard is unavailable." << std::endl;
+    return false;
+  }
+  if(planning_component != "right_arm")
+  {
+    std::cout << "[ERROR] Unknown planning component " << planning_component << "." << std::endl;
+    return false;
+  }
+  std_msgs::msg::Float64 msg;
+  msg.data = force_threshold;
+  right_contact_guard_publisher_->publish(msg);
+  return true;
+}
+
+
 void MotionCoordinator::add_object(std::string object_id, std::vector<double> pose, bool eulerzyx, std::vector<float> rgba)
 {
   if(eulerzyx)
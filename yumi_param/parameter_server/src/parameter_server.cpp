@@ -125,7 +125,7 @@ void ParameterServer::handle_GetControllerPid(const std::shared_ptr<rmw_request_
   {
     if (param.find(request->controller + ".pid") != std::string::npos) 
     {
-      // Get the specific parameter (p,i,d,i_min,i_max or antiwindup)
+      // Get the specific parameter (p,i,d,i_min,i_max,antiwindup or d_cutoff)
       std::vector<size_t> dotPos = {};
       for (size_t i = 0; i < param.size(); i++) 
       {
@@ -182,6 +182,13 @@ void ParameterServer::handle_GetControllerPid(const std::shared_ptr<rmw_request_
         RCLCPP_DEBUG(this->get_logger(), "antiwindup: %s", antiwindupValStr.c_str());
         response->antiwindup = to_bool(antiwindupValStr);
       } 
+      else if (pidParamName == "d_cutoff") 
+      {
+        auto pidParam = this->get_parameter(param);
+        auto d_cutoffValStr = pidParam.value_to_string();
+        RCLCPP_DEBUG(this->get_logger(), "d_cutoff: %s", d_cutoffValStr.c_str());
+        response->d_cutoff = std::stod(d_cutoffValStr);
+      } 
       else 
       {
         auto pidParam = this->get_parameter(param);